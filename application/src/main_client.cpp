@@ -45,6 +45,11 @@ int main(int argc, char** argv)
     options.add_options()
 		("q,quiet", "Quiet the logger")
 		("g,game", "Game root path", cxxopts::value<std::string>()->default_value("../../game"))
+		("t,tick-rate", "Fixed simulation ticks per second", cxxopts::value<int32_t>()->default_value("60"))
+		("b,broadphase", "Entity broadphase, rtree or hash", cxxopts::value<std::string>()->default_value("rtree"))
+		("cell-size", "Spatial hash cell size in pixels", cxxopts::value<double>()->default_value("128"))
+		("free-surfaces", "Drop images from CPU memory once they are uploaded as textures")
+		("stream-radius", "Only load tile images this many pixels around the players, 0 loads them all", cxxopts::value<double>()->default_value("0"))
 	;
 
     auto args = options.parse(argc, argv);
@@ -59,6 +64,10 @@ int main(int argc, char** argv)
 
         const std::string game_root = args["game"].as<std::string>();
         auto game = raptr::Game::create(game_root);
+        game->set_tick_rate(args["tick-rate"].as<int32_t>());
+        game->set_broadphase(args["broadphase"].as<std::string>(), args["cell-size"].as<double>());
+        game->config->keep_surfaces = args["free-surfaces"].count() == 0;
+        game->config->stream_radius_px = args["stream-radius"].as<double>();
         server.attach(game);
 
         if (!server.connect()) {
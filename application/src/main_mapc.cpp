@@ -0,0 +1,49 @@
+#include <cxxopts.hpp>
+#include <string>
+#include <vector>
+
+#include <raptr/common/filesystem.hpp>
+#include <raptr/common/logging.hpp>
+#include <raptr/game/map.hpp>
+
+namespace {
+auto logger = raptr::_get_logger(__FILE__);
+};
+
+int main(int argc, char** argv)
+{
+    spdlog::set_level(spdlog::level::info);
+
+    cxxopts::Options options("raptr-mapc",
+        "Compile map.json exports into map.rmap files that load without parsing.");
+
+    options.add_options()
+		("g,game", "Game root path", cxxopts::value<std::string>()->default_value("../../game"))
+		("maps", "Map folders relative to the game root, e.g. maps/prologue", cxxopts::value<std::vector<std::string>>())
+	;
+    options.parse_positional({ "maps" });
+
+    auto args = options.parse(argc, argv);
+    if (!args["maps"].count()) {
+        logger->error("No maps were given. Usage: raptr-mapc -g <game root> maps/<name> [maps/<name> ...]");
+        return -1;
+    }
+
+    raptr::FileInfo game_path;
+    game_path.game_root = args["game"].as<std::string>();
+    if (!raptr::fs::exists(game_path.game_root)) {
+        logger->error("{} does not exist!", game_path.game_root);
+        return -1;
+    }
+
+    int32_t failures = 0;
+    for (const auto& name : args["maps"].as<std::vector<std::string>>()) {
+        const auto folder = game_path.from_root(name);
+        if (!raptr::Map::compile(folder, folder.file_path / "map.rmap")) {
+            logger->error("Failed to compile {}", name);
+            ++failures;
+        }
+    }
+
+    return failures == 0 ? 0 : -1;
+}
@@ -21,6 +21,11 @@ int main(int argc, char** argv)
     options.add_options()
 		("q,quiet", "Quiet the logger")
 		("g,game", "Game root path", cxxopts::value<std::string>()->default_value("../../game"))
+		("t,tick-rate", "Fixed simulation ticks per second", cxxopts::value<int32_t>()->default_value("60"))
+		("b,broadphase", "Entity broadphase, rtree or hash", cxxopts::value<std::string>()->default_value("rtree"))
+		("cell-size", "Spatial hash cell size in pixels", cxxopts::value<double>()->default_value("128"))
+		("n,ticks", "Fast-forward this many ticks on a virtual clock, then exit", cxxopts::value<uint64_t>()->default_value("0"))
+		("d,dt", "Microseconds per fast-forwarded tick; 0 uses the tick rate", cxxopts::value<int64_t>()->default_value("0"))
 	;
 
     auto args = options.parse(argc, argv);
@@ -33,6 +38,14 @@ int main(int argc, char** argv)
         std::string game_root = args["game"].as<std::string>();
         raptr::Server server(game_root, "127.0.0.1:7272");
         server.fps = 20;
+        server.game->set_tick_rate(args["tick-rate"].as<int32_t>());
+        server.game->set_broadphase(args["broadphase"].as<std::string>(), args["cell-size"].as<double>());
+
+        const auto ticks = args["ticks"].as<uint64_t>();
+        if (ticks > 0) {
+            server.game->fast_forward(ticks, args["dt"].as<int64_t>());
+            return 0;
+        }
 
         if (!server.bind()) {
             logger->error("Failed to bind server!");
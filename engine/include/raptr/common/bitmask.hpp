@@ -0,0 +1,106 @@
+/*!
+  \file bitmask.hpp
+  One bit per pixel collision masks. Each row is packed into 64-bit words, so
+  two masks are tested against each other by shifting one row into the
+  other's frame and ANDing whole words, stopping at the first non-zero word.
+  Masks that are entirely solid or entirely empty are flagged so the row walk
+  can be skipped altogether.
+*/
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace raptr {
+class Bitmask {
+public:
+    Bitmask() = default;
+
+    /*!
+    Pack a region of an image into a mask. A pixel is solid if its first byte is non-zero.
+    Row 0 of the mask is the bottom row of the image unless flip_y is set, matching
+    how the game places sprites and tiles.
+    \param pixels - The first byte of the region's top-left pixel
+    \param pitch - The number of bytes between image rows
+    \param bytes_per_pixel - The number of bytes between pixels in a row
+    \param width - The width of the region in pixels
+    \param height - The height of the region in pixels
+    \param flip_x - Mirror the region left to right
+    \param flip_y - Mirror the region top to bottom
+    \return The mask
+  */
+    static Bitmask from_pixels(const uint8_t* pixels, int32_t pitch, int32_t bytes_per_pixel,
+        int32_t width, int32_t height, bool flip_x = false, bool flip_y = false);
+
+    /*!
+    Whether a solid pixel of this mask lands on a solid pixel of another
+    \param other - The other mask
+    \param dx - Where other's column 0 sits in this mask's columns
+    \param dy - Where other's row 0 sits in this mask's rows
+    \return Whether the masks overlap
+  */
+    bool overlaps(const Bitmask& other, int32_t dx, int32_t dy) const;
+
+    //! Whether any pixel in columns [x0, x1) and rows [y0, y1) is solid
+    bool any(int32_t x0, int32_t y0, int32_t x1, int32_t y1) const;
+
+    //! Whether one pixel is solid; anything outside the mask is not
+    bool test(int32_t x, int32_t y) const;
+
+    int32_t width() const
+    {
+        return w;
+    }
+
+    int32_t height() const
+    {
+        return h;
+    }
+
+    //! No pixel is solid, so nothing can ever overlap it
+    bool empty() const
+    {
+        return is_empty;
+    }
+
+    //! Every pixel is solid, so any overlap of its box is a collision
+    bool opaque() const
+    {
+        return is_opaque;
+    }
+
+private:
+    //! 64 bits of a row starting at column x, which may start or run outside the mask
+    uint64_t bits_at(int32_t y, int32_t x) const;
+
+    //! Both masks are at most 64 pixels wide, so every row is a single word
+    bool overlaps_narrow(const Bitmask& other, int32_t dx, int32_t x0, int32_t x1, int32_t y0, int32_t y1, int32_t dy) const;
+
+    int32_t w = 0;
+    int32_t h = 0;
+    int32_t words = 0;
+    bool is_empty = true;
+    bool is_opaque = false;
+
+    //! Row-major words, bit i of word k of a row being column k * 64 + i
+    std::vector<uint64_t> rows;
+};
+
+/*!
+  A mask in each of the four orientations a sprite or tile can be drawn in,
+  built once at load time so flips cost nothing when testing
+*/
+struct CollisionMasks {
+    static std::shared_ptr<const CollisionMasks> from_pixels(const uint8_t* pixels, int32_t pitch,
+        int32_t bytes_per_pixel, int32_t width, int32_t height);
+
+    const Bitmask& get(bool flip_x, bool flip_y) const
+    {
+        return variants[(flip_x ? 1 : 0) | (flip_y ? 2 : 0)];
+    }
+
+    //! Indexed by flip_x | flip_y << 1
+    Bitmask variants[4];
+};
+} // namespace raptr
@@ -0,0 +1,281 @@
+/*!
+  \file broadphase.hpp
+  The broadphase answers "what might overlap this box?" for the game's
+  entities. Two implementations share one interface so they can be swapped at
+  runtime: the R-tree, and a uniform grid spatial hash that is much cheaper to
+  keep up to date when many small entities move every tick.
+
+  Every entry carries a tag next to its box: collision category and mask bits
+  and a kind. A filtered query rejects entries by tag before the caller ever
+  sees them.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <raptr/common/rect.hpp>
+#include <raptr/common/rtree.hpp>
+#include <raptr/common/slot_map.hpp>
+
+namespace raptr {
+//! Whether two boxes touch or overlap
+inline bool bounds_overlap(const Bounds& a, const Bounds& b)
+{
+    return !(a.min[0] > b.max[0] || b.min[0] > a.max[0]
+        || a.min[1] > b.max[1] || b.min[1] > a.max[1]);
+}
+
+//! Whether inner lies entirely within outer
+inline bool bounds_contain(const Bounds& outer, const Bounds& inner)
+{
+    return inner.min[0] >= outer.min[0] && inner.max[0] <= outer.max[0]
+        && inner.min[1] >= outer.min[1] && inner.max[1] <= outer.max[1];
+}
+
+/*!
+  Enlarge a box for the broadphase, so small moves stay inside it and do not
+  need to be reinserted
+  \param bounds - The exact box
+  \param margin - Padding added on every side
+  \param dx - The predicted horizontal displacement; the box is stretched towards it
+  \param dy - The predicted vertical displacement
+  \return The enlarged box
+*/
+inline Bounds fatten_bounds(const Bounds& bounds, double margin, double dx, double dy)
+{
+    return Bounds(
+        bounds.min[0] - margin + std::min(dx, 0.0),
+        bounds.max[0] + margin + std::max(dx, 0.0),
+        bounds.min[1] - margin + std::min(dy, 0.0),
+        bounds.max[1] + margin + std::max(dy, 0.0));
+}
+
+//! Called for each entry found by a query; return false to stop early
+using BroadphaseCallback = bool (*)(SlotHandle handle, void* context);
+
+//! How many kinds a filter can tell apart, one bit each in BroadphaseFilter::kinds
+constexpr uint8_t BroadphaseKinds = 32;
+
+//! What an entry is and what it collides with, stored beside its box
+struct BroadphaseTag {
+    //! The categories this entry belongs to
+    uint32_t category = 1;
+
+    //! The categories this entry collides with
+    uint32_t mask = ~0u;
+
+    //! What sort of thing the entry is, below BroadphaseKinds; its meaning is up to the owner of the broadphase
+    uint8_t kind = 0;
+
+    bool operator==(const BroadphaseTag& other) const
+    {
+        return category == other.category && mask == other.mask && kind == other.kind;
+    }
+};
+
+//! Who is asking a query, and which kinds of entry they want back
+struct BroadphaseFilter {
+    uint32_t category = ~0u;
+    uint32_t mask = ~0u;
+
+    //! A bit per kind, 1 << kind, that may be reported
+    uint32_t kinds = ~0u;
+};
+
+/*!
+  Whether a query filter lets an entry through. Both sides must accept each
+  other's category, so an entry whose mask is 0 is never reported to a
+  filtered query.
+*/
+inline bool filter_accepts(const BroadphaseFilter& filter, const BroadphaseTag& tag)
+{
+    assert(tag.kind < BroadphaseKinds && "Broadphase kinds must fit in the filter's kind bits");
+    return (filter.kinds & (1u << (tag.kind % BroadphaseKinds))) != 0
+        && (tag.category & filter.mask) != 0
+        && (filter.category & tag.mask) != 0;
+}
+
+//! One entry of a batch insert
+struct BroadphaseEntry {
+    SlotHandle handle;
+    Bounds bounds;
+    BroadphaseTag tag;
+};
+
+class Broadphase {
+public:
+    virtual ~Broadphase() = default;
+
+    /*!
+    Create a broadphase by name
+    \param kind - "rtree" or "hash"
+    \param cell_size - The cell size in pixels, only used by the spatial hash
+    \return The broadphase, or null if the kind is not known
+  */
+    static std::unique_ptr<Broadphase> create(const std::string& kind, double cell_size = 128);
+
+    virtual void insert(SlotHandle handle, const Bounds& bounds, const BroadphaseTag& tag = BroadphaseTag()) = 0;
+
+    //! Insert many entries at once; a broadphase that packs better from a batch will do so
+    virtual void insert_batch(const std::vector<BroadphaseEntry>& entries);
+
+    //! Remove an entry; bounds must be the box it was last inserted or moved with
+    virtual void remove(SlotHandle handle, const Bounds& bounds) = 0;
+
+    //! Move an entry; from must be the box it was last inserted or moved with
+    virtual void move(SlotHandle handle, const Bounds& from, const Bounds& to) = 0;
+
+    //! Replace an entry's tag; bounds must be the box it was last inserted or moved with
+    virtual void retag(SlotHandle handle, const Bounds& bounds, const BroadphaseTag& tag) = 0;
+
+    /*!
+    Report every entry whose box overlaps the query box and whose tag the
+    filter accepts, each one once
+    \param filter - Who is asking, or null to report every overlapping entry
+    \return How many entries were reported
+  */
+    virtual size_t query(const Bounds& bounds, const BroadphaseFilter* filter, BroadphaseCallback callback, void* context) const = 0;
+
+    //! Report every entry whose box overlaps the query box, each one once
+    size_t query(const Bounds& bounds, BroadphaseCallback callback, void* context) const
+    {
+        return this->query(bounds, nullptr, callback, context);
+    }
+
+    virtual void clear() = 0;
+
+    virtual size_t size() const = 0;
+
+    //! The name create() knows this broadphase by
+    virtual const char* name() const = 0;
+};
+
+/*!
+  The original R-tree broadphase. Moving an entry is a remove and an insert.
+  A large batch insert repacks the whole tree with STR bulk loading, which
+  suits static geometry that is loaded once and then only queried.
+*/
+class RTreeBroadphase : public Broadphase {
+public:
+    using Broadphase::query;
+
+    void insert(SlotHandle handle, const Bounds& bounds, const BroadphaseTag& tag = BroadphaseTag()) override;
+    void insert_batch(const std::vector<BroadphaseEntry>& entries) override;
+    void remove(SlotHandle handle, const Bounds& bounds) override;
+    void move(SlotHandle handle, const Bounds& from, const Bounds& to) override;
+    void retag(SlotHandle handle, const Bounds& bounds, const BroadphaseTag& tag) override;
+    size_t query(const Bounds& bounds, const BroadphaseFilter* filter, BroadphaseCallback callback, void* context) const override;
+    void clear() override;
+    size_t size() const override;
+    const char* name() const override;
+
+private:
+    //! The leaf data of the tree; entries are identified by their handle alone.
+    //! Tree nodes keep leaf data in a union, so this stays trivially constructible.
+    struct Item {
+        SlotHandle handle;
+        uint32_t category;
+        uint32_t mask;
+        uint8_t kind;
+
+        static Item make(SlotHandle handle, const BroadphaseTag& tag)
+        {
+            return { handle, tag.category, tag.mask, tag.kind };
+        }
+
+        BroadphaseTag tag() const
+        {
+            BroadphaseTag tag;
+            tag.category = category;
+            tag.mask = mask;
+            tag.kind = kind;
+            return tag;
+        }
+
+        bool operator==(const Item& other) const
+        {
+            return handle == other.handle;
+        }
+    };
+
+    //! RTree::Search is not declared const, but it does not modify the tree
+    using Tree = RTree<Item, double, 2>;
+    mutable Tree tree;
+    size_t count = 0;
+};
+
+/*!
+  A uniform grid hashed by cell coordinate. Each cell is a flat array of the
+  handles that touch it, and each entry's box is kept in a table indexed by
+  its slot, along with its tag. Moving an entry within the same cells only
+  updates that table.
+*/
+class SpatialHashBroadphase : public Broadphase {
+public:
+    /*!
+    \param cell_size - The width and height of a cell in pixels. Something
+      around the size of a typical moving entity works best.
+  */
+    explicit SpatialHashBroadphase(double cell_size);
+
+    using Broadphase::query;
+
+    void insert(SlotHandle handle, const Bounds& bounds, const BroadphaseTag& tag = BroadphaseTag()) override;
+    void remove(SlotHandle handle, const Bounds& bounds) override;
+    void move(SlotHandle handle, const Bounds& from, const Bounds& to) override;
+    void retag(SlotHandle handle, const Bounds& bounds, const BroadphaseTag& tag) override;
+    size_t query(const Bounds& bounds, const BroadphaseFilter* filter, BroadphaseCallback callback, void* context) const override;
+    void clear() override;
+    size_t size() const override;
+    const char* name() const override;
+
+    double cell_size() const
+    {
+        return cell;
+    }
+
+    //! How many cells hold at least one entry
+    size_t cell_count() const
+    {
+        return cells.size();
+    }
+
+private:
+    //! The inclusive range of cells a box touches
+    struct CellRange {
+        int32_t x0, y0, x1, y1;
+
+        bool operator==(const CellRange& other) const
+        {
+            return x0 == other.x0 && y0 == other.y0 && x1 == other.x1 && y1 == other.y1;
+        }
+    };
+
+    CellRange cells_for(const Bounds& bounds) const;
+    static uint64_t key(int32_t x, int32_t y);
+    void add(SlotHandle handle, const CellRange& range);
+
+    //! Take a handle out of every cell in a range; false if no cell held it
+    bool drop(SlotHandle handle, const CellRange& range);
+
+    double cell;
+    double inv_cell;
+    std::unordered_map<uint64_t, std::vector<SlotHandle>> cells;
+
+    struct Box {
+        Bounds bounds;
+        BroadphaseTag tag;
+    };
+
+    //! The current box and tag of every entry, indexed by its slot index
+    std::vector<Box> boxes;
+    size_t count = 0;
+};
+} // namespace raptr
@@ -11,4 +11,14 @@ bool toggle();
 void start();
 void stop();
 
+/*!
+  Switch between wall-clock time and a virtual clock that only moves when
+  advance() is called. ticks() carries on from the same value either way.
+*/
+void set_virtual(bool enabled);
+bool is_virtual();
+
+//! Move the virtual clock forward; does nothing on the wall clock
+void advance(int64_t delta_us);
+
 } // namespace raptr::clock
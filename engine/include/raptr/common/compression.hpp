@@ -0,0 +1,50 @@
+/*!
+  \file compression.hpp
+  Decoding for the compact forms the map editor can export data in: base64
+  text, optionally compressed with zlib, gzip or zstd. zstd is only available
+  when the engine is built with RAPTR_WITH_ZSTD.
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace raptr {
+
+enum class Compression {
+    None,
+    Zlib,
+    Gzip,
+    Zstd
+};
+
+/*!
+  Look up a compression by the name the map editor uses
+  \param name - "", "zlib", "gzip" or "zstd"
+  \param compression - Set to the compression if the name is known
+  \return Whether the name is known
+*/
+bool compression_from_name(const std::string& name, Compression& compression);
+
+/*!
+  Decode standard base64, ignoring whitespace
+  \param text - The encoded text
+  \param out - Replaced with the decoded bytes
+  \return False if the text has any other character outside the alphabet or is cut short
+*/
+bool base64_decode(const std::string& text, std::vector<uint8_t>& out);
+
+/*!
+  Decompress a buffer whose decompressed size is known up front
+  \param compression - How the input was compressed
+  \param in - The compressed bytes
+  \param in_size - How many compressed bytes there are
+  \param out - Where to write the decompressed bytes
+  \param out_size - Exactly how many bytes the input decompresses to
+  \return False if the input is corrupt, decompresses to any other size or the compression is not built in
+*/
+bool decompress(Compression compression, const uint8_t* in, size_t in_size, uint8_t* out, size_t out_size);
+
+} // namespace raptr
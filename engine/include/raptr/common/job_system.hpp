@@ -0,0 +1,122 @@
+/*!
+  \file job_system.hpp
+  A small work-stealing thread pool. Every worker owns a deque of jobs: it
+  takes new work from the back of its own deque and, when that runs dry,
+  steals from the front of another worker's. Jobs may depend on other jobs
+  and only become runnable once everything they depend on has finished.
+  Threads that wait on a job help run work instead of blocking. A job that
+  throws still counts as finished; the exception is rethrown to whoever
+  waits on it.
+*/
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace raptr {
+
+struct Job;
+
+//! A reference to a scheduled job that can be waited on or depended on
+using JobHandle = std::shared_ptr<Job>;
+
+struct Job {
+    std::function<void()> work;
+
+    //! How many dependencies must finish before this job can run
+    std::atomic<int32_t> unfinished_dependencies { 0 };
+
+    //! Set once work() has returned or thrown
+    std::atomic<bool> done { false };
+
+    //! What work() threw, if it did; written before done is set
+    std::exception_ptr error;
+
+    //! Jobs that are waiting on this one to finish
+    std::mutex continuations_mutex;
+    std::vector<JobHandle> continuations;
+};
+
+class JobSystem {
+public:
+    /*!
+    Start the worker threads
+    \param num_workers - How many threads to start; 0 means one less than the hardware threads
+  */
+    explicit JobSystem(size_t num_workers = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    /*!
+    Schedule a job to run once all of its dependencies have finished
+    \param work - What the job does
+    \param dependencies - Jobs that must finish first
+    \return A handle to the job
+  */
+    JobHandle schedule(std::function<void()> work, const std::vector<JobHandle>& dependencies = {});
+
+    /*!
+    Block until a job has finished, running other jobs in the meantime.
+    If the job threw, the exception is rethrown here.
+  */
+    void wait(const JobHandle& job);
+
+    /*!
+    Split [0, count) into chunks of at most grain items and run fn(begin, end)
+    on each chunk across the workers. Returns once every chunk has finished,
+    then rethrows the first exception a chunk threw, if any. The calling
+    thread runs chunks too.
+  */
+    void parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn);
+
+    //! How many worker threads there are, not counting threads that call wait()
+    size_t worker_count() const
+    {
+        return workers.size();
+    }
+
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<JobHandle> jobs;
+    };
+
+    void worker_loop(size_t index);
+
+    //! Run jobs until one has finished, without rethrowing what it threw
+    void help_until_done(const JobHandle& job);
+
+    //! The queue the calling thread owns in this system, or the shared one for threads outside it
+    size_t home() const;
+
+    void enqueue(const JobHandle& job);
+    void finish(const JobHandle& job);
+    bool run_one(size_t home);
+    JobHandle pop_or_steal(size_t home);
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+
+    //! Round-robin target for jobs scheduled from outside the pool
+    std::atomic<size_t> next_queue { 0 };
+
+    //! How many jobs are sitting in the queues
+    std::atomic<int64_t> queued { 0 };
+
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    std::atomic<bool> shutdown { false };
+};
+
+} // namespace raptr
@@ -0,0 +1,52 @@
+/*!
+  \file mapped_file.hpp
+  A read-only view of a whole file mapped into memory. Reads go straight to
+  the page cache, so large files can be used in place without reading them
+  into a buffer first.
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include <raptr/common/filesystem.hpp>
+
+namespace raptr {
+class MappedFile {
+public:
+    /*!
+    Map a file for reading
+    \param path - The file to map
+    \return The mapping, or nullptr if the file does not exist, is empty or could not be mapped
+  */
+    static std::unique_ptr<MappedFile> open(const fs::path& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const
+    {
+        return bytes;
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+private:
+    MappedFile() = default;
+
+    const uint8_t* bytes = nullptr;
+    size_t length = 0;
+
+#if defined(_WIN32)
+    void* file = nullptr;
+    void* mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+} // namespace raptr
@@ -0,0 +1,125 @@
+/*!
+  \file mpsc_queue.hpp
+  A bounded, lock-free multi-producer/single-consumer queue. Any thread may
+  push, but only one thread (the game thread) may pop. Each cell carries a
+  sequence number so producers claim slots with a single compare-and-swap and
+  the consumer never has to take a lock. When the queue is full, the push
+  fails and is counted as a drop rather than blocking the producer.
+*/
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace raptr {
+template <class T>
+class MpscQueue {
+public:
+    /*!
+    Create a queue that can hold the requested number of items
+    \param capacity_ - Rounded up to the next power of two
+  */
+    explicit MpscQueue(size_t capacity_ = 1024)
+    {
+        size_t capacity = 2;
+        while (capacity < capacity_) {
+            capacity <<= 1;
+        }
+        mask = capacity - 1;
+        cells.reset(new Cell[capacity]);
+        for (size_t i = 0; i < capacity; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    /*!
+    Push an item from any thread
+    \param value - The item to move into the queue
+    \return False if the queue was full and the item was dropped
+  */
+    template <class U>
+    bool try_push(U&& value)
+    {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells[pos & mask];
+            const size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->data = std::forward<U>(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /*!
+    Pop the oldest item. Must only be called from the consuming thread.
+    \param out - Where the item is moved to
+    \return False if the queue was empty
+  */
+    bool try_pop(T& out)
+    {
+        const size_t pos = head.load(std::memory_order_relaxed);
+        Cell* cell = &cells[pos & mask];
+        const size_t seq = cell->sequence.load(std::memory_order_acquire);
+        if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1) < 0) {
+            return false;
+        }
+
+        out = std::move(cell->data);
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        head.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    //! An approximate count of how many items are waiting to be popped
+    size_t depth() const
+    {
+        const auto t = tail.load(std::memory_order_relaxed);
+        const auto h = head.load(std::memory_order_relaxed);
+        return t > h ? t - h : 0;
+    }
+
+    //! How many pushes have failed because the queue was full
+    uint64_t drops() const
+    {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+    size_t capacity() const
+    {
+        return mask + 1;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+
+    //! Producers and the consumer live on separate cache lines
+    alignas(64) std::atomic<size_t> tail { 0 };
+    alignas(64) std::atomic<size_t> head { 0 };
+    alignas(64) std::atomic<uint64_t> dropped { 0 };
+};
+} // namespace raptr
@@ -0,0 +1,114 @@
+/*!
+  \file ring_buffer.hpp
+  A growable FIFO ring whose slots stay constructed between uses. Popping an
+  element does not destroy it, so the storage behaves like a per-frame arena:
+  once the ring has warmed up, pushing a record reuses a previous slot (and
+  whatever capacity its members were holding) instead of allocating.
+*/
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace raptr {
+template <class T>
+class RingBuffer {
+public:
+    /*!
+    Create a ring with room for at least the requested number of records
+    \param capacity_ - Rounded up to the next power of two
+  */
+    explicit RingBuffer(size_t capacity_ = 64)
+    {
+        size_t capacity = 1;
+        while (capacity < capacity_) {
+            capacity <<= 1;
+        }
+        slots.resize(capacity);
+    }
+
+    /*!
+    Claim the next slot at the back of the ring. The slot still holds
+    whatever record was last stored there and should be overwritten.
+    If the ring is full, then the capacity doubles.
+    \return The slot that is now the back of the ring
+  */
+    T& push_back()
+    {
+        if (count == slots.size()) {
+            this->grow();
+        }
+        auto& slot = slots[(head + count) & (slots.size() - 1)];
+        ++count;
+        return slot;
+    }
+
+    void push_back(T&& value)
+    {
+        this->push_back() = std::move(value);
+    }
+
+    T& front()
+    {
+        return slots[head];
+    }
+
+    //! Give back the most recently claimed slot
+    void pop_back()
+    {
+        --count;
+    }
+
+    //! Release the front slot back to the ring without destroying it
+    void pop_front()
+    {
+        head = (head + 1) & (slots.size() - 1);
+        --count;
+    }
+
+    void clear()
+    {
+        head = 0;
+        count = 0;
+    }
+
+    bool empty() const
+    {
+        return count == 0;
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    size_t capacity() const
+    {
+        return slots.size();
+    }
+
+    //! How many times the ring has had to double since it was created
+    size_t growths() const
+    {
+        return growth_count;
+    }
+
+private:
+    void grow()
+    {
+        std::vector<T> larger(slots.size() * 2);
+        for (size_t i = 0; i < count; ++i) {
+            larger[i] = std::move(slots[(head + i) & (slots.size() - 1)]);
+        }
+        slots.swap(larger);
+        head = 0;
+        ++growth_count;
+    }
+
+    std::vector<T> slots;
+    size_t head = 0;
+    size_t count = 0;
+    size_t growth_count = 0;
+};
+} // namespace raptr
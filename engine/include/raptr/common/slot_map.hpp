@@ -0,0 +1,178 @@
+/*!
+  \file slot_map.hpp
+  A slot map hands out small generational handles to the values it stores.
+  A handle packs a slot index and the generation of that slot into 32 bits.
+  When a value is erased its slot's generation is bumped, so any handle still
+  pointing at it resolves to nothing instead of to whatever reuses the slot.
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace raptr {
+/*!
+  A generational handle into a SlotMap. The default value of zero is never
+  handed out, so a value-initialized handle is always null. This type is kept
+  trivial so it can be stored in unions and in the r-tree.
+*/
+struct SlotHandle {
+    static constexpr uint32_t index_bits = 20;
+    static constexpr uint32_t index_mask = (1u << index_bits) - 1;
+    static constexpr uint32_t max_generation = (1u << (32 - index_bits)) - 1;
+
+    uint32_t value;
+
+    static SlotHandle make(uint32_t index, uint32_t generation)
+    {
+        return { (generation << index_bits) | (index & index_mask) };
+    }
+
+    uint32_t index() const
+    {
+        return value & index_mask;
+    }
+
+    uint32_t generation() const
+    {
+        return value >> index_bits;
+    }
+
+    explicit operator bool() const
+    {
+        return value != 0;
+    }
+
+    bool operator==(const SlotHandle& other) const
+    {
+        return value == other.value;
+    }
+
+    bool operator!=(const SlotHandle& other) const
+    {
+        return value != other.value;
+    }
+
+    bool operator<(const SlotHandle& other) const
+    {
+        return value < other.value;
+    }
+};
+
+template <class T>
+class SlotMap {
+public:
+    //! How many values fit at once; every index has to fit in a handle's index bits
+    static constexpr size_t max_size = static_cast<size_t>(SlotHandle::index_mask) + 1;
+
+    /*!
+    Store a value and return a handle to it
+    \param value - The value to store
+    \return A handle that resolves to the value until it is erased, or a null
+      handle if max_size values are already stored
+  */
+    SlotHandle insert(T value)
+    {
+        uint32_t index;
+        if (free_head != npos) {
+            index = free_head;
+            free_head = slots[index].next_free;
+        } else {
+            if (slots.size() >= max_size) {
+                return {};
+            }
+            index = static_cast<uint32_t>(slots.size());
+            slots.push_back({});
+        }
+
+        auto& slot = slots[index];
+        slot.value = std::move(value);
+        slot.occupied = true;
+        ++count;
+        return SlotHandle::make(index, slot.generation);
+    }
+
+    /*!
+    Erase the value a handle refers to. Handles to it become stale.
+    \return False if the handle was already stale
+  */
+    bool erase(SlotHandle handle)
+    {
+        if (!this->contains(handle)) {
+            return false;
+        }
+
+        const auto index = handle.index();
+        auto& slot = slots[index];
+        slot.value = T();
+        slot.occupied = false;
+
+        // Generation zero is reserved so that a zeroed handle is never valid
+        slot.generation = slot.generation == SlotHandle::max_generation ? 1 : slot.generation + 1;
+        slot.next_free = free_head;
+        free_head = index;
+        --count;
+        return true;
+    }
+
+    bool contains(SlotHandle handle) const
+    {
+        const auto index = handle.index();
+        return index < slots.size()
+            && slots[index].occupied
+            && slots[index].generation == handle.generation();
+    }
+
+    //! Resolve a handle in O(1), or nullptr if it is stale
+    T* get(SlotHandle handle)
+    {
+        return this->contains(handle) ? &slots[handle.index()].value : nullptr;
+    }
+
+    const T* get(SlotHandle handle) const
+    {
+        return this->contains(handle) ? &slots[handle.index()].value : nullptr;
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    void clear()
+    {
+        for (uint32_t i = 0; i < slots.size(); ++i) {
+            if (slots[i].occupied) {
+                this->erase(SlotHandle::make(i, slots[i].generation));
+            }
+        }
+    }
+
+private:
+    static constexpr uint32_t npos = ~0u;
+
+    struct Slot {
+        T value = T();
+        uint32_t generation = 1;
+        uint32_t next_free = npos;
+        bool occupied = false;
+    };
+
+    std::vector<Slot> slots;
+    uint32_t free_head = npos;
+    size_t count = 0;
+};
+} // namespace raptr
+
+namespace std {
+template <>
+struct hash<raptr::SlotHandle> {
+    size_t operator()(const raptr::SlotHandle& handle) const
+    {
+        return std::hash<uint32_t>()(handle.value);
+    }
+};
+} // namespace std
@@ -0,0 +1,99 @@
+/*!
+  \file sweep.hpp
+  Swept box tests. Rather than testing a moving box at a few points along its
+  path, these find the exact fraction of the move at which it first touches
+  something, so fast movers can not step over thin geometry.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include <raptr/common/rect.hpp>
+
+namespace raptr {
+//! Where along a move a swept box first touches another box
+struct SweepContact {
+    //! The fraction of the move travelled before contact, in [0, 1]
+    double toi;
+
+    //! The face that was hit, pointing back towards the moving box
+    Point normal;
+};
+
+/*!
+  Find when a box moving in a straight line first overlaps a fixed box.
+  Boxes that only touch do not overlap, so sliding along a surface or moving
+  away from one is not a contact. A box that starts out overlapping reports a
+  contact at 0 against the axis it is moving along most.
+  \param moving - The box at the start of the move
+  \param delta - How far it moves
+  \param fixed - The box it may run into
+  \param contact - Set to the contact, if there is one
+  \return Whether the boxes overlap at any point during the move
+*/
+inline bool sweep_rect(const Rect& moving, const Point& delta, const Rect& fixed, SweepContact& contact)
+{
+    const double moving_min[] = { moving.x, moving.y };
+    const double moving_max[] = { moving.x + moving.w, moving.y + moving.h };
+    const double fixed_min[] = { fixed.x, fixed.y };
+    const double fixed_max[] = { fixed.x + fixed.w, fixed.y + fixed.h };
+    const double d[] = { delta.x, delta.y };
+
+    auto t_enter = -std::numeric_limits<double>::infinity();
+    auto t_exit = 1.0;
+    int32_t enter_axis = -1;
+
+    for (int32_t axis = 0; axis < 2; ++axis) {
+        if (d[axis] == 0) {
+            // Not moving on this axis, so the boxes must already overlap on it
+            if (moving_max[axis] <= fixed_min[axis] || moving_min[axis] >= fixed_max[axis]) {
+                return false;
+            }
+            continue;
+        }
+
+        auto t0 = (fixed_min[axis] - moving_max[axis]) / d[axis];
+        auto t1 = (fixed_max[axis] - moving_min[axis]) / d[axis];
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+
+        if (t0 > t_enter) {
+            t_enter = t0;
+            enter_axis = axis;
+        }
+        t_exit = std::min(t_exit, t1);
+    }
+
+    if (enter_axis < 0 || t_exit <= 0 || t_enter >= t_exit) {
+        return false;
+    }
+
+    if (t_enter < 0) {
+        enter_axis = std::fabs(d[0]) >= std::fabs(d[1]) ? 0 : 1;
+    }
+
+    contact.toi = std::max(t_enter, 0.0);
+    contact.normal = { 0, 0 };
+    if (enter_axis == 0) {
+        contact.normal.x = d[0] > 0 ? -1 : 1;
+    } else {
+        contact.normal.y = d[1] > 0 ? -1 : 1;
+    }
+    return true;
+}
+
+//! The smallest rectangle holding a box at both ends of a move
+inline Rect swept_rect(const Rect& moving, const Point& delta)
+{
+    Rect swept;
+    swept.x = moving.x + std::min(delta.x, 0.0);
+    swept.y = moving.y + std::min(delta.y, 0.0);
+    swept.w = moving.w + std::fabs(delta.x);
+    swept.h = moving.h + std::fabs(delta.y);
+    return swept;
+}
+} // namespace raptr
@@ -0,0 +1,207 @@
+/*!
+  \file timing_wheel.hpp
+  A hierarchical timing wheel measured in simulation ticks. Timers due soon
+  sit in the slots of the finest wheel; timers due later sit in coarser
+  wheels and are cascaded down as their time approaches. Scheduling and
+  cancelling are O(1), and advancing a tick only touches the timers that
+  are due (plus, every 64 ticks, one slot's worth of cascading).
+*/
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace raptr {
+template <class T>
+class TimingWheel {
+public:
+    //! Identifies a scheduled timer; zero is never handed out
+    using TimerId = uint64_t;
+
+    static constexpr uint32_t slot_bits = 6;
+    static constexpr uint32_t slots_per_level = 1u << slot_bits;
+    static constexpr uint32_t levels = 4;
+
+    /*!
+    Create an empty wheel
+    \param now - The tick that has already been processed
+  */
+    explicit TimingWheel(uint64_t now = 0)
+        : current(now)
+    {
+        for (auto& level : wheel) {
+            level.fill(npos);
+        }
+    }
+
+    /*!
+    Schedule a value to fire on a tick
+    \param due - The tick to fire on; anything not after now() fires on the next tick
+    \param value - What is handed back when the timer fires
+    \return An id that can be cancelled
+  */
+    TimerId schedule(uint64_t due, T value)
+    {
+        uint32_t index;
+        if (free_head != npos) {
+            index = free_head;
+            free_head = nodes[index].next;
+        } else {
+            index = static_cast<uint32_t>(nodes.size());
+            nodes.push_back({});
+        }
+
+        auto& node = nodes[index];
+        node.value = std::move(value);
+        node.live = true;
+        ++node.generation;
+        ++count;
+
+        this->link(index, due > current ? due : current + 1);
+        return (static_cast<uint64_t>(node.generation) << 32) | index;
+    }
+
+    /*!
+    Stop a timer from firing. The slot it occupies is reclaimed lazily.
+    \return False if the timer already fired or was cancelled
+  */
+    bool cancel(TimerId id)
+    {
+        const auto index = static_cast<uint32_t>(id & 0xffffffffu);
+        const auto generation = static_cast<uint32_t>(id >> 32);
+        if (index >= nodes.size() || nodes[index].generation != generation || !nodes[index].live) {
+            return false;
+        }
+
+        nodes[index].live = false;
+        nodes[index].value = T();
+        --count;
+        return true;
+    }
+
+    /*!
+    Process every tick up to and including now. For each timer that comes due,
+    fire(value) is called and returns the tick the timer should fire again on,
+    or 0 to finish. A repeating timer keeps its id.
+  */
+    template <class F>
+    void advance(uint64_t now, F&& fire)
+    {
+        while (current < now) {
+            ++current;
+
+            // When a wheel wraps, the next slot of the coarser wheel is due to be spread out
+            for (uint32_t level = 1; level < levels; ++level) {
+                if ((current & ((1ull << (slot_bits * level)) - 1)) != 0) {
+                    break;
+                }
+                this->cascade(level, (current >> (slot_bits * level)) & (slots_per_level - 1));
+            }
+
+            auto& head = wheel[0][current & (slots_per_level - 1)];
+            auto index = head;
+            head = npos;
+            while (index != npos) {
+                const auto next = nodes[index].next;
+                if (!nodes[index].live) {
+                    this->release(index);
+                } else {
+                    // The callback may schedule more timers and move the node storage
+                    T value = std::move(nodes[index].value);
+                    const auto again = fire(value);
+                    if (!nodes[index].live) {
+                        this->release(index);
+                    } else if (again == 0) {
+                        nodes[index].live = false;
+                        nodes[index].value = T();
+                        --count;
+                        this->release(index);
+                    } else {
+                        nodes[index].value = std::move(value);
+                        this->link(index, again > current ? again : current + 1);
+                    }
+                }
+                index = next;
+            }
+        }
+    }
+
+    //! The last tick that has been processed
+    uint64_t now() const
+    {
+        return current;
+    }
+
+    //! How many timers are waiting to fire
+    size_t size() const
+    {
+        return count;
+    }
+
+private:
+    static constexpr uint32_t npos = ~0u;
+
+    struct Node {
+        T value = T();
+        uint64_t due = 0;
+        uint32_t next = npos;
+        uint32_t generation = 0;
+        bool live = false;
+    };
+
+    //! Put a node in the slot matching how far away it is due; due must not be before now
+    void link(uint32_t index, uint64_t due)
+    {
+        auto& node = nodes[index];
+        node.due = due;
+
+        const auto delta = node.due - current;
+        uint32_t level = 0;
+        while (level + 1 < levels && delta >= (1ull << (slot_bits * (level + 1)))) {
+            ++level;
+        }
+
+        // Beyond the coarsest wheel, park it as far out as possible and re-check on cascade
+        auto slot_tick = node.due;
+        const auto horizon = 1ull << (slot_bits * levels);
+        if (delta >= horizon) {
+            slot_tick = current + horizon - 1;
+        }
+
+        auto& head = wheel[level][(slot_tick >> (slot_bits * level)) & (slots_per_level - 1)];
+        node.next = head;
+        head = index;
+    }
+
+    //! Move every node in a coarse slot down to where it now belongs
+    void cascade(uint32_t level, uint64_t slot)
+    {
+        auto index = wheel[level][slot];
+        wheel[level][slot] = npos;
+        while (index != npos) {
+            const auto next = nodes[index].next;
+            if (nodes[index].live) {
+                this->link(index, nodes[index].due);
+            } else {
+                this->release(index);
+            }
+            index = next;
+        }
+    }
+
+    void release(uint32_t index)
+    {
+        nodes[index].next = free_head;
+        free_head = index;
+    }
+
+    std::array<std::array<uint32_t, slots_per_level>, levels> wheel;
+    std::vector<Node> nodes;
+    uint32_t free_head = npos;
+    uint64_t current;
+    size_t count = 0;
+};
+} // namespace raptr
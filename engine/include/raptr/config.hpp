@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstdint>
+#include <string>
+
 namespace raptr {
 class Config {
 public:
@@ -9,5 +12,45 @@ public:
     Config(Config&&) = default;
     Config& operator=(const Config&) = default;
     Config& operator=(Config&&) = default;
+
+public:
+    //! How many fixed simulation ticks run per second of game time
+    int32_t tick_rate_hz = 60;
+
+    //! The most ticks a single frame may run while catching up after a stall
+    int32_t max_catchup_ticks = 5;
+
+    //! How many events other threads may have posted before new ones are dropped
+    int32_t event_queue_capacity = 4096;
+
+    //! Worker threads for the job system; 0 uses one less than the hardware threads
+    int32_t job_threads = 0;
+
+    //! How many entities a single plan job handles during a tick
+    int32_t plan_batch_size = 32;
+
+    //! Which broadphase tracks entity bounds, "rtree" or "hash"
+    std::string broadphase = "rtree";
+
+    //! The spatial hash cell size in pixels
+    double broadphase_cell_size = 128;
+
+    //! Padding in pixels around each entity's box in the broadphase
+    double broadphase_margin_px = 4;
+
+    //! How many ticks of velocity each broadphase box is stretched by
+    double broadphase_lookahead_ticks = 4;
+
+    //! Keep images in CPU memory after they are uploaded as textures; collision only needs their masks
+    bool keep_surfaces = true;
+
+    //! Tile images are only loaded within this many pixels of a player or the camera; 0 loads every tile with the map
+    double stream_radius_px = 0;
+
+    //! How much further than the stream radius a chunk must be before its tiles are unloaded again
+    double stream_hysteresis_px = 512;
+
+    //! How many streamed tile textures the render thread creates per frame
+    int32_t stream_uploads_per_frame = 8;
 };
 } // namespace raptr
@@ -79,6 +79,15 @@ public:
   */
     void think(std::shared_ptr<Game>& game) override;
 
+    //! Timers, tweens, and input that change the character's own velocity
+    void prepare(std::shared_ptr<Game>& game) override;
+
+    //! Gravity, friction, and collision against a read-only world
+    bool plan(Game& game) override;
+
+    //! Apply the planned movement, then animation, scripts and interaction
+    void commit(std::shared_ptr<Game>& game) override;
+
     /*!
     Trigger the "Run" animation and set the movement speed to run speed 
     \param scale - A 0.0-1.0 multiplier that will be used to calculate the final run speed
@@ -101,6 +110,8 @@ public:
     virtual void walk(float scale);
 
     /*!
+    Walk towards a point over the following ticks. The walk is driven from
+    think() on the game thread until the character is within a few pixels.
   */
     virtual void move_to(double x, double y, float scale);
     virtual void move_to_rel(double x, double y, float scale);
@@ -155,6 +166,9 @@ private:
 
     void set_animation(const std::string& name);
 
+    //! Step towards the current tween destination, called once per think
+    void think_tween();
+
 public:
     //! The controller that is bound to this character
     std::shared_ptr<Controller> controller;
@@ -166,9 +180,27 @@ public:
     bool flashlight;
     std::shared_ptr<Sprite> flashlight_sprite;
 
+    //! The outcome of plan(), waiting to be committed
+    struct ThinkPlan {
+        Point pos;
+        Point vel;
+        Point acc;
+        bool flip_x_changed;
+        bool flip_x;
+        bool flip_y;
+        const char* animation;
+    } pending;
+
     //! If true, then a tweening is occuring
     bool is_tweening;
 
+    //! Where the current tween is walking to and how fast
+    Point tween_dst;
+    float tween_scale;
+
+    //! If set, then the character is nudged exactly onto tween_dst on arrival
+    bool tween_snap;
+
     //! If the think() determines the character is falling down, then this will be set
     bool is_falling;
 
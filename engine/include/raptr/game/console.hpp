@@ -5,13 +5,14 @@
 #pragma once
 
 #include <iostream>
-#include <mutex>
 #include <sol/sol.hpp>
 #include <sstream>
 #include <string>
 #include <thread>
 #include <vector>
 
+#include <raptr/common/mpsc_queue.hpp>
+
 namespace raptr {
 
 class Console {
@@ -34,8 +35,11 @@ public:
     bool shutdown;
     sol::state lua;
     std::thread think_thread;
-    std::mutex mutex;
-    std::vector<std::string> commands;
+
+    //! Commands read on the console thread waiting to run on the game thread
+    MpscQueue<std::string> commands;
+
+    //! Only touched by the console thread to expand "!"
     std::string last_command;
 };
 
@@ -7,13 +7,20 @@
 #include <array>
 #include <cstdint>
 #include <memory>
+#include <raptr/common/broadphase.hpp>
 #include <raptr/common/rect.hpp>
+#include <raptr/game/entity_handle.hpp>
+#include <raptr/game/entity_store.hpp>
 #include <raptr/network/snapshot.hpp>
 #include <raptr/renderer/renderer.hpp>
 #include <sol/sol.hpp>
 #include <string>
 #include <vector>
 
+namespace toml {
+class Value;
+} // namespace toml
+
 namespace raptr {
 
 constexpr double magic_feel_good_number = 3;
@@ -32,6 +39,43 @@ struct AnimationFrame;
 
 typedef std::array<unsigned char, 16> GUID;
 
+//! Velocity one entity hands to another during the plan phase of a tick
+struct VelocityHandoff {
+    EntityHandle to;
+    bool x_axis;
+    double value;
+};
+
+/*!
+  How often an entity thinks, based on how far it is from every player and the camera
+*/
+enum class Activity : uint8_t {
+    //! Thinks every tick
+    Active,
+    //! Thinks every ActivityConfig::reduced_think_us
+    Reduced,
+    //! Does not think or animate until it comes back in range or is woken
+    Asleep
+};
+
+/*!
+  Activity radii for an entity type, read from the [activity] table of its TOML.
+  A radius of zero disables that level, so by default an entity is always active.
+*/
+struct ActivityConfig {
+    //! Beyond this many pixels from every player and the camera, think at the reduced rate
+    double reduced_radius_px = 0;
+
+    //! Beyond this many pixels, stop thinking altogether
+    double sleep_radius_px = 0;
+
+    //! How often a reduced entity thinks
+    int64_t reduced_think_us = 250000;
+
+    //! How long an entity stays active after it is woken
+    int64_t wake_us = 1000000;
+};
+
 /*!
   An Entity is any object in the world that can be interacted with by the player.
   This could be a static mesh, a character, or a simple platform. The idea is that
@@ -113,6 +157,46 @@ public:
   */
     virtual void think(std::shared_ptr<Game>& game) = 0;
 
+    /*!
+    A simulation tick runs in three phases: prepare (serial), plan (parallel),
+    and commit (serial, in entity order). Entities that do not override plan()
+    simply think() during the commit phase.
+  */
+    virtual void prepare(std::shared_ptr<Game>& game) {}
+
+    /*!
+    Work out where this entity wants to be at the end of the tick. Plans run in
+    parallel, so this may only read the world and may only write state that no
+    other entity reads while planning.
+    \return Whether the entity planned; if false, think() is called on commit
+  */
+    virtual bool plan(Game& game) { return false; }
+
+    /*!
+    Apply what plan() decided
+  */
+    virtual void commit(std::shared_ptr<Game>& game) {}
+
+    /*!
+    Read the optional [activity] table of an actor or character TOML
+    \param root - The parsed TOML document
+  */
+    void load_activity(const toml::Value& root);
+
+    /*!
+    Read the optional [collision] table (category and mask) of an actor or character TOML
+    \param root - The parsed TOML document
+  */
+    void load_collision_filter(const toml::Value& root);
+
+    /*!
+    Sleeping entities are off-camera, so they neither render nor animate. The
+    first time one renders again, its animation is caught up to the present.
+    Reduced entities still render every frame.
+    \return Whether rendering should be skipped this frame
+  */
+    bool skip_dormant_render();
+
     /*!
     Given the current position, velocity, and acceleration, where does this entity *want* to go in X
     \return The rectangle this entity *wants* to occupy in the X direction
@@ -131,42 +215,49 @@ public:
   */
     virtual Point& position_rel()
     {
-        return pos_;
+        return store ? store->position[store_index] : pos_;
     }
 
     virtual const Point& position_rel() const
     {
-        return pos_;
+        return store ? store->position[store_index] : pos_;
     }
 
     virtual Point position_abs() const
     {
         if (parent) {
-            return parent->position_abs() + pos_;
+            return parent->position_abs() + this->position_rel();
         }
-        return pos_;
+        return this->position_rel();
     }
 
+    /*!
+    Return where the entity should be drawn between the previous and current tick
+    \param alpha - How far into the next tick the renderer is [0, 1)
+    \return The interpolated absolute position
+  */
+    virtual Point render_position(double alpha) const;
+
     /*!
     Return the current velocity of the entity
     \return A double-precision point of the Entity velocity
   */
     virtual Point& velocity_rel()
     {
-        return vel_;
+        return store ? store->velocity[store_index] : vel_;
     }
 
     virtual const Point& velocity_rel() const
     {
-        return vel_;
+        return store ? store->velocity[store_index] : vel_;
     }
 
     virtual Point velocity_abs() const
     {
         if (parent) {
-            return parent->velocity_abs() + vel_;
+            return parent->velocity_abs() + this->velocity_rel();
         }
-        return vel_;
+        return this->velocity_rel();
     }
 
     /*!
@@ -175,28 +266,39 @@ public:
   */
     virtual Point& acceleration_rel()
     {
-        return acc_;
+        return store ? store->acceleration[store_index] : acc_;
     }
 
     virtual const Point& acceleration_rel() const
     {
-        return acc_;
+        return store ? store->acceleration[store_index] : acc_;
     }
 
     virtual Point acceleration_abs() const
     {
         if (parent) {
-            return parent->acceleration_abs() + acc_;
+            return parent->acceleration_abs() + this->acceleration_rel();
         }
-        return acc_;
+        return this->acceleration_rel();
     }
 
+    /*!
+    Copy the state held in the EntityStore back into pos_, vel_ and acc_
+  */
+    void sync_detached();
+
     virtual void add_velocity(double x_kmh, double y_kmh);
 
     virtual void add_acceleration(double x_ms2, double y_ms2);
 
     virtual bool is_player() const;
 
+    //! Whether the collision categories and masks of two entities let them touch
+    bool collides_with(const Entity* other) const;
+
+    //! The tag the broadphase stores next to this entity's box
+    BroadphaseTag broadphase_tag() const;
+
     virtual void show_collision_frame();
 
     virtual void hide_collision_frame();
@@ -214,21 +316,65 @@ public:
     //! The name of the entity
     std::string name;
 
-    //! The unique ID of the entity
+    //! The unique ID of the entity, only used to identify it over the network
     std::array<unsigned char, 16> guid_;
 
+    //! The handle the game refers to this entity by, null until it is spawned
+    EntityHandle handle;
+
+    //! Where the entity sits in Game::entities, so it can be unlinked without a search
+    uint32_t entities_index;
+
+    //! Set once the entity is queued for removal at the end of the tick
+    bool pending_removal;
+
+    //! How far this entity may drift from the action before it thinks less
+    ActivityConfig activity_config;
+    Activity activity;
+
+    //! The simulation tick this entity last thought on, and stays active until
+    uint64_t last_think_tick;
+    uint64_t awake_until_tick;
+
+    //! The simulated time the current think covers; more than one tick if it was dormant
+    int64_t think_delta_us;
+
+    //! Set while rendering is skipped, so the animation is caught up once it is not
+    bool render_skipped;
+
     //! Is collision possible?
     bool collidable;
 
-    //! The current position
-    Point pos_;
+    //! What this entity is; set by the constructor of each entity type
+    EntityKind kind;
 
-    //! The current velocity
-    Point vel_;
+    /*!
+    The categories this entity belongs to and the categories it collides with.
+    Two entities only collide if each one's mask has a bit of the other's
+    category. Once spawned, change them through Game::set_collision_filter.
+  */
+    uint32_t collision_category;
+    uint32_t collision_mask;
+
+    //! Not expected to move; the game keeps it in its packed static broadphase until it does
+    bool is_static;
 
-    //! The current acceleration
+    /*!
+    The position, velocity, and acceleration while the entity is not in the
+    game. Once spawned, the EntityStore row is authoritative and these are
+    only refreshed by sync_detached() so the network snapshot can read them.
+  */
+    Point pos_;
+    Point vel_;
     Point acc_;
 
+    //! Velocity this entity gives to others, applied once every entity has committed
+    std::vector<VelocityHandoff> handoffs;
+
+    //! The store holding this entity's per-tick state, or null if not spawned
+    EntityStore* store;
+    uint32_t store_index;
+
     //! How long the entity has been falling in milliseconds, if any
     int64_t fall_time_us;
 
@@ -241,7 +387,11 @@ public:
     //! The sprite that is used to render this character
     std::shared_ptr<Sprite> sprite;
 
+    //! If positive, the entity only thinks this often, as scheduled by the game's timing wheel
     int64_t think_rate_us;
-    int64_t last_think_time_us;
+
+    //! Set while the timing wheel holds this entity's next think, and once that think is due
+    bool think_scheduled;
+    bool think_due;
 };
 } // namespace raptr
@@ -0,0 +1,39 @@
+/*!
+  \file entity_handle.hpp
+  Entities are referred to by generational handles into the game's slot map.
+  This header is kept tiny so the renderer can hold handles without pulling
+  in the rest of the game.
+*/
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include <raptr/common/slot_map.hpp>
+
+namespace raptr {
+class Entity;
+
+//! A 32-bit handle that resolves to an Entity in O(1), or to nothing once it is removed
+using EntityHandle = SlotHandle;
+
+//! Owner of every spawned entity, indexed by EntityHandle
+using EntitySlots = SlotMap<std::shared_ptr<Entity>>;
+
+//! What an entity is, kept in the broadphase so queries can ask for one kind without casting
+enum class EntityKind : uint8_t {
+    Other = 0,
+    Actor,
+    Character,
+    Trigger,
+};
+
+//! The BroadphaseFilter::kinds bit for a kind
+constexpr uint32_t entity_kind_bit(EntityKind kind)
+{
+    return 1u << static_cast<uint32_t>(kind);
+}
+
+//! Every kind of entity
+constexpr uint32_t AnyEntityKind = ~0u;
+} // namespace raptr
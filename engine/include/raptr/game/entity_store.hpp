@@ -0,0 +1,78 @@
+/*!
+  \file entity_store.hpp
+  Per-tick entity state stored as contiguous component arrays. Every spawned
+  Entity owns one dense row in the store and its position, velocity and
+  acceleration accessors read and write that row directly. Walking every
+  entity in a tick is then a linear scan over a few arrays rather than a walk
+  over shared pointers and map lookups.
+*/
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <raptr/common/rect.hpp>
+#include <raptr/game/entity_handle.hpp>
+
+namespace raptr {
+class Entity;
+
+//! Cached per-entity flags so the tick does not need to touch the Entity
+enum EntityFlag : uint8_t {
+    EntityFlagCollidable = 1 << 0,
+    EntityFlagPixelTest = 1 << 1,
+    EntityFlagDead = 1 << 2,
+};
+
+class EntityStore {
+public:
+    /*!
+    Give an entity a row in the store. The entity's detached position,
+    velocity and acceleration are copied in and from then on its accessors
+    refer to the store.
+    \param entity - The entity to attach; must not already be attached
+    \return The dense index of the new row
+  */
+    uint32_t attach(Entity* entity);
+
+    /*!
+    Remove an entity's row. Its current state is copied back into the entity
+    so it stays usable, and the last row is swapped into the hole.
+    \param entity - The entity to detach
+  */
+    void detach(Entity* entity);
+
+    /*!
+    Refresh the cached flags of a row from the entity that owns it
+  */
+    void refresh_flags(uint32_t index);
+
+    size_t size() const
+    {
+        return owner.size();
+    }
+
+public:
+    //! The relative position, velocity and acceleration of each entity
+    std::vector<Point> position;
+    std::vector<Point> velocity;
+    std::vector<Point> acceleration;
+
+    //! The absolute position at the start of the last simulation tick
+    std::vector<Point> prev_position;
+
+    //! The absolute position and bounds the broadphase last saw
+    std::vector<Point> last_position;
+    std::vector<Bounds> last_bounds;
+
+    //! The enlarged box the broadphase holds, replaced only once last_bounds leaves it
+    std::vector<Bounds> fat_bounds;
+
+    //! EntityFlag bits, refreshed after each think
+    std::vector<uint8_t> flags;
+
+    //! Back-references from a dense row to the entity it belongs to
+    std::vector<Entity*> owner;
+    std::vector<EntityHandle> handle;
+};
+} // namespace raptr
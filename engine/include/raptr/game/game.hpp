@@ -12,14 +12,22 @@
 #include <map>
 #include <memory>
 #include <thread>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 #include <crossguid/guid.hpp>
 #include <sol/sol.hpp>
 
+#include <raptr/common/broadphase.hpp>
 #include <raptr/common/filesystem.hpp>
+#include <raptr/common/job_system.hpp>
+#include <raptr/common/mpsc_queue.hpp>
 #include <raptr/common/rect.hpp>
-#include <raptr/common/rtree.hpp>
+#include <raptr/common/ring_buffer.hpp>
+#include <raptr/common/timing_wheel.hpp>
+#include <raptr/game/entity_handle.hpp>
+#include <raptr/game/entity_store.hpp>
 #include <raptr/network/snapshot.hpp>
 
 namespace raptr {
@@ -29,10 +37,42 @@ class Entity;
 class Renderer;
 class Sound;
 class Map;
+struct Tile;
 
 using IntersectEntityFilter = std::function<bool(const Entity*)>;
 using IntersectCharacterFilter = std::function<bool(const Character*)>;
 
+/*!
+  Something the game's timing wheel fires: either an entity's next think or a
+  timed callback from a script
+*/
+struct GameTimer {
+    //! The entity whose think comes due, if there is no callback
+    EntityHandle entity;
+
+    std::function<void()> callback;
+
+    //! Ticks between callbacks, or 0 to only fire once
+    uint64_t interval_ticks;
+};
+
+using GameTimers = TimingWheel<GameTimer>;
+
+//! The first thing a moving entity runs into, as found by Game::sweep
+struct SweepHit {
+    bool hit = false;
+
+    //! The fraction of the move that can be made without touching anything
+    double toi = 1;
+
+    //! The face that was hit, pointing back towards the entity
+    Point normal = { 0, 0 };
+
+    //! What was hit: an entity, or a map tile
+    Entity* entity = nullptr;
+    const Tile* tile = nullptr;
+};
+
 /*!
   The Game is a class that ties together the Renderer, Sound, Input, and Entities
   into one cohesive interaction. It can be thought of the main loop of the application
@@ -54,18 +94,11 @@ public:
     Game& operator=(const Game&) = delete;
     Game& operator=(Game&&) = default;
 
-    std::shared_ptr<Entity>& operator[](const std::string& key)
-    {
-        if (key.size() == 16) {
-            std::array<unsigned char, 16> new_key;
-            std::copy(key.begin(), key.end(), new_key.begin());
-            const auto found = entity_lut.find(new_key);
-            if (found != entity_lut.end()) {
-                return found->second;
-            }
-        }
-        return entity_short_lut[key];
-    }
+    /*!
+    Find an entity by its short name or by its 16-byte GUID string
+    \return The entity, or nullptr if nothing is known by that key
+  */
+    std::shared_ptr<Entity> operator[](const std::string& key) const;
 
 public:
     /*!
@@ -80,22 +113,100 @@ public:
         return std::dynamic_pointer_cast<T>(entity);
     }
 
+    /*!
+    Resolve a handle to the entity it refers to in O(1)
+    \return The entity, or nullptr if it has been removed since
+  */
+    std::shared_ptr<Entity> resolve(EntityHandle handle) const
+    {
+        const auto entity = entity_slots.get(handle);
+        return entity ? *entity : nullptr;
+    }
+
+    template <class T>
+    std::shared_ptr<T> resolve(EntityHandle handle) const
+    {
+        return std::dynamic_pointer_cast<T>(this->resolve(handle));
+    }
+
+    /*!
+    Find the handle of an entity by the GUID it is known by on the network
+    \return The handle, or a null handle if no such entity exists
+  */
+    EntityHandle handle_from_guid(const GUID& guid) const;
+
+    /*!
+    Give an entity a short name that can be used with operator[] and get_entity
+  */
+    void set_entity_name(const std::string& name, const std::shared_ptr<Entity>& entity);
+
     /*!
     A headless server. One that does not render or use sound, etc.
   */
     static std::shared_ptr<Game> create_headless(const fs::path& game_root);
 
+    /*!
+    Queue an event to be dispatched at the start of the next frame. This is
+    safe to call from any thread and is the only way work should be handed
+    to the game thread. Events from the game thread itself go straight into
+    the growable event ring and are never dropped; other threads share the
+    bounded queue.
+    \param event - One of the EngineEventData event types
+    \return False if the event queue was full and the event was dropped
+  */
     template <class T>
-    void add_event(T* event)
+    bool post_event(T&& event)
     {
-        engine_events_buffers[engine_event_index].push_back(EngineEvent::create<T>(event));
+        if (std::this_thread::get_id() == game_thread) {
+            auto& engine_event = engine_events_buffers[engine_event_index].push_back();
+            engine_event.time = clock::ticks();
+            engine_event.data = std::forward<T>(event);
+            return true;
+        }
+
+        EngineEvent engine_event;
+        engine_event.time = clock::ticks();
+        engine_event.data = std::forward<T>(event);
+        return posted_events->try_push(std::move(engine_event));
     }
 
+    //! How many posted events are waiting for the next frame
+    size_t event_queue_depth() const;
+
+    //! How many posted events have been dropped because the queue was full
+    uint64_t event_queue_drops() const;
+
+    /*!
+    Set how much room entities get in the broadphase before they have to be
+    reinserted. Boxes pick up the new sizes the next time they are reinserted.
+    \param margin_px - Padding on every side of an entity's box
+    \param lookahead_ticks - How many ticks of velocity to stretch the box by
+  */
+    void set_broadphase_margin(double margin_px, double lookahead_ticks);
+
+    //! How many times an entity's bounds have moved since the game started
+    uint64_t broadphase_updates() const;
+
+    //! How many of those moves left the enlarged box and were reinserted
+    uint64_t broadphase_reinserts() const;
+
+    //! The share of moves that were reinserted, 0 before anything has moved
+    double broadphase_reinsert_rate() const;
+
+    /*!
+    Change which categories an entity belongs to and collides with, and update
+    the tag the broadphase holds for it
+    \param entity - The entity to change
+    \param category - The categories it belongs to
+    \param mask - The categories it collides with
+  */
+    void set_collision_filter(const std::shared_ptr<Entity>& entity, uint32_t category, uint32_t mask);
+
     void kill_character(const std::shared_ptr<Character>& character);
     void kill_entity(const std::shared_ptr<Entity>& entity);
     void kill_by_guid(const std::array<unsigned char, 16>& guid);
 
-    void dispatch_event(const std::shared_ptr<EngineEvent>& event);
+    void dispatch_event(EngineEvent& event);
 
     void handle_load_map_event(const LoadMapEvent& event);
 
@@ -122,6 +233,123 @@ public:
 
     bool intersect_anything(Entity* entity, const Rect& bbox);
 
+    /*!
+    Find the first collidable tile or entity a box runs into as it moves in a
+    straight line. Every candidate is swept as a box in one pass, and only the
+    earliest contacts are refined per pixel, so a fast mover can not pass
+    through thin geometry and no per-step intersection tests are needed.
+    \param entity - The entity that is moving; it is never hit itself
+    \param from - The entity's box at the start of the move
+    \param delta - How far it moves
+    \return The first contact, or a hit of false with a toi of 1 if the whole move is clear
+  */
+    SweepHit sweep(Entity* entity, const Rect& from, const Point& delta) const;
+
+    /*!
+    Visit every entity that collides with a box without allocating. This is
+    what the intersect_* methods are built on.
+    \param entity - The entity asking; it is never visited itself
+    \param bbox - The box to test
+    \param visit - Called as visit(Entity*) for each hit; return false to stop early
+    \param kinds - The entity_kind_bit of each kind to visit
+    \return How many entities were visited
+  */
+    template <class Visitor>
+    size_t for_each_intersecting(Entity* entity, const Rect& bbox, Visitor&& visit, uint32_t kinds = AnyEntityKind) const
+    {
+        struct Context {
+            const Game* game;
+            const Entity* self;
+            const Rect* bbox;
+            std::remove_reference_t<Visitor>* visit;
+            size_t visited;
+        } context { this, entity, &bbox, &visit, 0 };
+
+        // Categories, masks and kinds are rejected in the broadphase, before the entity is touched
+        const auto filter = this->collision_filter(entity, kinds);
+        this->query_entities(
+            Bounds(bbox.x, bbox.x + bbox.w, bbox.y, bbox.y + bbox.h), &filter, [](EntityHandle handle, void* opaque) -> bool {
+                const auto context = reinterpret_cast<Context*>(opaque);
+                const auto found = context->game->narrow_phase(context->self, handle, *context->bbox);
+                if (!found) {
+                    return true;
+                }
+                ++context->visited;
+                return (*context->visit)(found);
+            },
+            &context);
+
+        return context.visited;
+    }
+
+    /*!
+    Write the entities that collide with a box and pass a filter into a
+    caller's buffer, stopping once it is full
+    \param entity - The entity asking; it is never reported itself
+    \param bbox - The box to test
+    \param out - Where to write the entities
+    \param capacity - How many entities out can hold
+    \param filter - Called as filter(Entity*); only entities it accepts are written
+    \return How many entities were written
+  */
+    template <class Filter>
+    size_t intersect_entities(Entity* entity, const Rect& bbox, Entity** out, size_t capacity, Filter&& filter) const
+    {
+        size_t written = 0;
+        if (capacity == 0) {
+            return 0;
+        }
+
+        this->for_each_intersecting(entity, bbox, [&](Entity* found) {
+            if (!filter(found)) {
+                return true;
+            }
+            out[written++] = found;
+            return written < capacity;
+        });
+        return written;
+    }
+
+    //! The same as the buffer form of intersect_entities, but only for characters
+    template <class Filter>
+    size_t intersect_characters(Entity* entity, const Rect& bbox, Character** out, size_t capacity, Filter&& filter) const
+    {
+        size_t written = 0;
+        if (capacity == 0) {
+            return 0;
+        }
+
+        this->for_each_intersecting(
+            entity, bbox, [&](Entity* found) {
+                const auto character = as_character(found);
+                if (!character || !filter(character)) {
+                    return true;
+                }
+                out[written++] = character;
+                return written < capacity;
+            },
+            entity_kind_bit(EntityKind::Character));
+        return written;
+    }
+
+    //! The first entity that collides with a box, or null
+    Entity* first_intersecting(Entity* entity, const Rect& bbox) const;
+
+    /*!
+    Decide whether a broadphase candidate really collides with a box
+    \param self - The entity asking, which never collides with itself; may be null
+    \param candidate - The handle the broadphase reported
+    \param bbox - The box to test
+    \return The entity, or null if it is gone, not collidable or does not touch the box
+  */
+    Entity* narrow_phase(const Entity* self, EntityHandle candidate, const Rect& bbox) const;
+
+    //! The broadphase filter for queries made on behalf of an entity, or for any entity if it is null
+    BroadphaseFilter collision_filter(const Entity* entity, uint32_t kinds = AnyEntityKind) const;
+
+    //! The entity as a character, or null if it is not one
+    static Character* as_character(Entity* entity);
+
     /*!
     Returns true if a given entity can teleport to a region defined by a bounding box
     \param entity - The entity that is trying to teleport
@@ -146,9 +374,26 @@ public:
         IntersectCharacterFilter post_filter = [](const Character*) -> bool { return true; },
         size_t limit = 0);
 
+    /*!
+    Report every entity whose broadphase box overlaps a box, static or dynamic
+    \param bounds - The box to search
+    \param callback - Called for each candidate; return false to stop early
+    \param context - Passed through to the callback
+    \return How many candidates were reported
+  */
+    size_t query_entities(const Bounds& bounds, BroadphaseCallback callback, void* context) const;
+
+    //! The same as query_entities, but only reporting candidates the filter accepts
+    size_t query_entities(const Bounds& bounds, const BroadphaseFilter* filter, BroadphaseCallback callback, void* context) const;
+
     void set_gravity(double m_s2);
 
-    void spawn_now(const std::shared_ptr<Entity>& entity);
+    /*!
+    Add an entity to the game right away, rather than through a spawn event
+    \param entity - The entity to add
+    \return False if every entity slot is in use and the entity was not added
+  */
+    bool spawn_now(const std::shared_ptr<Entity>& entity);
 
     /*!
     Spawn an entity to the world
@@ -186,8 +431,42 @@ public:
         });
 
     bool remove_entity_by_key(const std::string key);
+
+    /*!
+    Queue an entity (and its children) to leave the game at the end of the
+    current tick. The entity stays resolvable until then, so it is safe to
+    call from inside think() or a Lua callback.
+    \return False if the entity was already queued
+  */
     bool remove_entity(std::shared_ptr<Entity> entity);
 
+    /*!
+    Unlink every entity queued by remove_entity(). Runs once per tick.
+  */
+    void flush_removals();
+
+    /*!
+    Pack static entities spawned since the last call into the static
+    broadphase in one batch. Runs after each frame's events and before a tick.
+    \param rebuild - Repack every static entity rather than just the new ones
+  */
+    void pack_static_broadphase(bool rebuild = false);
+
+    /*!
+    Make a dormant entity think every tick again, for at least its configured wake time
+    \param entity - The entity to wake
+  */
+    void wake(const std::shared_ptr<Entity>& entity);
+
+    /*!
+    Decide which entities think this tick based on how far they are from
+    every player and the camera. Runs at the start of every tick.
+  */
+    void update_activity();
+
+    //! The boxes of every player and of the camera view, which dormancy and map streaming measure from
+    std::vector<Bounds> focus_bounds();
+
     /*!
     Run the game and manage maintaining a healthy FPS
     \return Whether or not the game successfully ran
@@ -199,9 +478,69 @@ public:
     bool gather_engine_events();
 
     /*!
+    Dispatch pending engine events and run as many fixed simulation ticks
+    as the elapsed wall time allows
+    \return Whether the frame was processed
   */
     bool process_engine_events();
 
+    /*!
+    Move everything posted from other threads into this frame's event ring and dispatch it
+  */
+    void dispatch_engine_events();
+
+    /*!
+    Advance every entity by exactly one fixed tick of sim_dt_us. This is the
+    only place entities think, so the client and server step identically.
+  */
+    void simulate_tick();
+
+    /*!
+    Change how many fixed simulation ticks run per second
+    \param hz - The new tick rate, must be positive
+  */
+    void set_tick_rate(int32_t hz);
+
+    /*!
+    Run ticks back-to-back on a virtual clock with no rendering and no
+    sleeping, then report how fast they ran. Must not be called from a tick
+    or from an event callback, and stops early if the game shuts down.
+    \param ticks - How many simulation ticks to run
+    \param dt_us - Simulated microseconds per tick; 0 keeps the current tick rate
+    \return Simulated ticks per second of wall time, counting only the ticks that ran
+  */
+    double fast_forward(uint64_t ticks, int64_t dt_us = 0);
+
+    /*!
+    Swap the broadphase and reinsert every spawned entity into it
+    \param kind - "rtree" or "hash"
+    \param cell_size - The spatial hash cell size in pixels
+    \return False if the kind is not known or this is called from a tick
+  */
+    bool set_broadphase(const std::string& kind, double cell_size);
+
+    /*!
+    Call a function once, after a delay of simulated time
+    \param delay_us - How long to wait, rounded up to whole ticks
+    \param callback - What to call on the game thread
+    \return An id for cancel_timer()
+  */
+    GameTimers::TimerId after(int64_t delay_us, std::function<void()> callback);
+
+    /*!
+    Call a function repeatedly at an interval of simulated time
+    \param interval_us - Time between calls, rounded up to whole ticks
+    \param callback - What to call on the game thread
+    \return An id for cancel_timer()
+  */
+    GameTimers::TimerId every(int64_t interval_us, std::function<void()> callback);
+
+    //! Stop a timer from after() or every(); false if it already finished
+    bool cancel_timer(GameTimers::TimerId id);
+
+    //! How many whole ticks cover a span of simulated time, at least one
+    uint64_t ticks_for(int64_t us) const;
+
     /*!
     Top-level function to call all other init functions
     \return Whether all init functions passed or not
@@ -278,18 +617,36 @@ public:
     std::vector<std::shared_ptr<Entity>> entities;
     std::vector<std::shared_ptr<Character>> characters;
 
+    //! Owns every spawned entity; everything else refers to them by handle
+    EntitySlots entity_slots;
+
     //! A mapping of short-cut IDs
-    std::map<std::string, std::shared_ptr<Entity>> entity_short_lut;
+    std::map<std::string, EntityHandle> entity_short_lut;
+
+    //! The reverse of entity_short_lut, so removing an entity does not scan every name
+    std::unordered_map<EntityHandle, std::vector<std::string>> entity_short_names;
 
-    //! A mapping of entity GUIDs to entities
-    std::map<std::array<unsigned char, 16>, std::shared_ptr<Entity>> entity_lut;
+    //! Entities waiting to be unlinked at the end of the tick
+    std::vector<std::shared_ptr<Entity>> removal_queue;
+
+    //! A mapping of entity GUIDs to handles, only needed for networking
+    std::map<GUID, EntityHandle> guid_to_handle;
+
+    //! Contiguous per-tick state (transform, velocity, bounds, flags) of every spawned entity
+    EntityStore entity_store;
+
+    /*!
+    Finds the entities a bounding box may touch, before the exact intersection
+    test. It holds each entity's fat_bounds from the entity store, so queries
+    may return entities that do not quite overlap.
+  */
+    std::unique_ptr<Broadphase> broadphase;
 
-    //! A map to find what the last known location of an entity was
-    std::map<std::shared_ptr<Entity>, Point> last_known_entity_pos;
-    std::map<std::shared_ptr<Entity>, Bounds> last_known_entity_bounds;
+    //! Entities that are not expected to move, bulk loaded into a packed R-tree
+    std::unique_ptr<Broadphase> static_broadphase;
 
-    //! The r-tree is used as a secondary test for bounding box interactions
-    RTree<Entity*, double, 2> rtree;
+    //! Static entities waiting to be packed; queries check them one by one until then
+    std::vector<EntityHandle> static_spawns;
 
     //! The root of the game folders to extract
     fs::path game_root;
@@ -299,13 +656,68 @@ public:
 
     int64_t input_received_us;
 
-    //! The number of ms since the last frame
+    //! The number of us the current simulation tick covers (always sim_dt_us)
     int64_t frame_delta_us;
 
     int64_t frame_last_time;
 
+    //! The fixed simulation step in microseconds
+    int64_t sim_dt_us;
+
+    //! Wall time that has elapsed, but has not been simulated yet
+    int64_t sim_accumulator_us;
+
+    //! How many ticks a single frame may run before the backlog is dropped
+    int32_t sim_max_catchup_ticks;
+
+    //! Runs the plan phase of each tick across threads
+    std::unique_ptr<JobSystem> jobs;
+
+    //! Whether each store row planned this tick, indexed like entity_store
+    std::vector<uint8_t> sim_planned;
+
+    //! Whether each store row thinks this tick, indexed like entity_store
+    std::vector<uint8_t> sim_thinking;
+
+    //! How many entities were reduced or asleep on the last tick
+    size_t sim_dormant;
+
+    //! Set while simulate_tick() is running, so it is not re-entered from a script
+    bool sim_in_tick;
+
+    //! Set while dispatch_engine_events() is running, so an event callback can not dispatch again
+    bool dispatching_events;
+
+    //! Bounds updates and broadphase reinsertions since the game started
+    uint64_t broadphase_update_count;
+    uint64_t broadphase_reinsert_count;
+
+    //! A store row's bounds enlarged by the configured margin and its predicted velocity
+    Bounds fat_bounds_for(uint32_t index) const;
+
+    //! Take a static entity out of the static broadphase, or out of the queue waiting to be packed
+    void unlink_static(EntityHandle handle, const Bounds& bounds);
+
+    //! Scheduled thinks and script timers, counted in ticks (a tick is now() once it has started)
+    GameTimers timers;
+
+    //! The number of simulation ticks that have run since the game started
+    uint64_t sim_tick;
+
+    //! How far the renderer is between the previous and the current tick [0, 1)
+    double sim_alpha;
+
+    //! The thread that called init() and runs the game loop, whose own events skip the bounded queue.
+    //! Written once before any other thread can post, so reads need no synchronization
+    std::thread::id game_thread;
+
+    //! Events posted from any thread, drained into the event ring once per frame
+    std::unique_ptr<MpscQueue<EngineEvent>> posted_events;
+    uint64_t posted_events_drops_seen;
+
+    //! Events are queued into one ring while the other is being dispatched
     int32_t engine_event_index = 0;
-    std::vector<std::shared_ptr<EngineEvent>> engine_events_buffers[2];
+    RingBuffer<EngineEvent> engine_events_buffers[2];
 
     std::shared_ptr<Map> map;
 
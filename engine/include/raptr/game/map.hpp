@@ -5,15 +5,20 @@
 */
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <SDL.h>
 #include <SDL_surface.h>
 
+#include <raptr/common/bitmask.hpp>
 #include <raptr/common/filesystem.hpp>
 #include <raptr/game/entity.hpp>
 #include <raptr/renderer/parallax.hpp>
@@ -22,21 +27,66 @@
 
 namespace raptr {
 
+class Config;
 class Game;
 class Dialog;
+class MapStreamer;
+
+/*!
+  Tile types from the map editor, interned when the map loads so collision
+  queries compare bits instead of strings. Types the engine does not know
+  about share the Other bit and are told apart by name.
+*/
+enum class TileFlag : uint8_t {
+    None = 0,
+    Collidable = 1 << 0,
+    Death = 1 << 1,
+    Interactive = 1 << 2,
+    Other = 1 << 7
+};
+
+//! The flag for a tile type name
+inline TileFlag tile_flag_from_type(const std::string& type)
+{
+    if (type == "Collidable") {
+        return TileFlag::Collidable;
+    } else if (type == "Death") {
+        return TileFlag::Death;
+    } else if (type == "Interactive") {
+        return TileFlag::Interactive;
+    } else if (type.empty() || type == "Non-Collidable") {
+        return TileFlag::None;
+    }
+    return TileFlag::Other;
+}
 
 struct Tile {
     bool loaded;
+
+    //! Whether the image is only loaded while a chunk near a player uses the tile
+    bool streamed = false;
+
+    //! Where the image is loaded from
+    std::string image;
     std::shared_ptr<SDL_Surface> surface;
     std::shared_ptr<SDL_Texture> texture;
     std::shared_ptr<Sprite> sprite;
     std::string type;
+    TileFlag flag = TileFlag::None;
     SDL_Rect src;
+
+    //! Which pixels of the tile image are solid; sprite tiles use their frames' masks
+    std::shared_ptr<const CollisionMasks> masks;
 };
 
+/*!
+  A tile with state of its own: a map object, or a placed tile that animates
+  and so needs its own sprite. Plain placed tiles are only a TileCell.
+*/
 struct LayerTile {
-    Tile* tile;
+    Tile* tile = nullptr;
     std::string type;
+    TileFlag flag = TileFlag::None;
     std::shared_ptr<Sprite> sprite;
     std::shared_ptr<Dialog> dialog;
     std::string script;
@@ -47,34 +97,315 @@ struct LayerTile {
     uint32_t index;
 };
 
+/*!
+  One placed tile in a layer, packed into 8 bytes. Everything else about it
+  comes from its Tile, or from the layer's side table if it has state.
+*/
+struct TileCell {
+    static const uint8_t FlipX = 1 << 0;
+    static const uint8_t FlipY = 1 << 1;
+    static const uint8_t Rotated = 1 << 2;
+
+    //! The tile's index in Map::tilemap, without the editor's flip bits; 0 is an empty cell
+    uint32_t gid = 0;
+
+    //! One past the tile's index in Layer::special, or 0 for a plain tile
+    uint16_t special = 0;
+
+    //! FlipX, FlipY and Rotated
+    uint8_t bits = 0;
+
+    //! The tile's TileFlag, kept here so scans do not touch the tilemap
+    uint8_t flag = 0;
+};
+static_assert(sizeof(TileCell) == 8, "TileCell should stay packed");
+
+/*!
+  A tile found by a map query: what it is and how it is drawn, plus the
+  LayerTile for objects and animated tiles
+*/
+struct TileRef {
+    Tile* tile = nullptr;
+    LayerTile* placed = nullptr;
+    bool flip_x = false;
+    bool flip_y = false;
+
+    explicit operator bool() const
+    {
+        return tile || placed;
+    }
+};
+
+//! Tiles along each side of a layer chunk and of a collision grid chunk
+const uint32_t TileChunkSize = 32;
+
+/*!
+  A square block of a layer's cells, kept up to date as tiles change so
+  drawing can skip whatever the cameras can not see
+*/
+struct TileChunk {
+    //! Everything the chunk's tiles draw over, in world coordinates
+    Rect bounds;
+
+    //! Every TileFlag of the chunk's tiles
+    uint8_t flags = 0;
+
+    //! How many of the chunk's cells hold a tile
+    uint16_t count = 0;
+
+    //! Whether the chunk is drawn and its tiles' images are kept loaded
+    bool resident = false;
+};
+
 struct Layer {
+    //! The chunk holding a cell, by column and row from the top
+    uint32_t chunk_of(uint32_t x, uint32_t row) const
+    {
+        return (row / TileChunkSize) * chunks_wide + x / TileChunkSize;
+    }
+
+    //! A reference to the tile in a cell, by its row-major index from the top row
+    TileRef tile_at(std::vector<Tile>& tilemap, uint32_t idx)
+    {
+        TileRef ref;
+        const auto& cell = cells[idx];
+        if (cell.gid == 0) {
+            return ref;
+        }
+
+        ref.tile = &tilemap[cell.gid];
+        ref.placed = cell.special ? &special[cell.special - 1] : nullptr;
+        ref.flip_x = (cell.bits & TileCell::FlipX) != 0;
+        ref.flip_y = (cell.bits & TileCell::FlipY) != 0;
+        return ref;
+    }
+
     std::string name;
-    std::vector<uint32_t> data;
-    std::vector<uint32_t> tile_table;
-    std::vector<LayerTile> renderable;
-    std::map<uint32_t, LayerTile> layer_tile_lut;
+
+    //! Every cell of the layer, row-major from the top row
+    std::vector<TileCell> cells;
+
+    //! The few placed tiles that need state of their own
+    std::vector<LayerTile> special;
+
+    //! Slots of special (counted from 1, as in TileCell) that no cell uses, reused before it grows
+    std::vector<uint16_t> free_special;
+
+    //! Row-major from the top, chunks_wide to a row
+    std::vector<TileChunk> chunks;
+    uint32_t chunks_wide = 0;
     int32_t x, y;
     uint32_t width, height;
     bool is_foreground;
 };
 
+/*!
+  The tile flags of every layer merged into one byte per cell, so a query can
+  rule out most of an area without touching any layer. Cells are in tile
+  units with y increasing upwards, as the layers are placed in the world.
+  Each chunk of cells also has its flags merged, so whole chunks without
+  what a query wants are skipped.
+*/
+struct CollisionGrid {
+    //! The chunk holding a cell, which must be inside the grid
+    uint32_t chunk_of(int32_t cx, int32_t cy) const
+    {
+        return static_cast<uint32_t>(cy - y) / TileChunkSize * chunks_wide + static_cast<uint32_t>(cx - x) / TileChunkSize;
+    }
+
+    //! The flags of a cell, or nothing outside the grid
+    uint8_t at(int32_t cx, int32_t cy) const
+    {
+        if (cx < x || cy < y || cx >= x + width || cy >= y + height) {
+            return 0;
+        }
+        return cells[static_cast<size_t>(cy - y) * width + (cx - x)];
+    }
+
+    //! The lowest cell column and row the grid covers
+    int32_t x = 0, y = 0;
+    int32_t width = 0, height = 0;
+    std::vector<uint8_t> cells;
+
+    //! The flags of each chunk, row-major from the bottom, chunks_wide to a row
+    std::vector<uint8_t> chunk_flags;
+    uint32_t chunks_wide = 0;
+};
+
 class Map : public RenderInterface {
 public:
-    static std::shared_ptr<Map> load(const FileInfo& folder);
+    ~Map();
+
+    /*!
+    Load a map and its tilesets. A map.rmap is used instead of map.json unless
+    map.json or a tileset or image it was compiled from has changed since.
+    \param folder - The folder holding map.json
+    \param config - Whether and how far around the players tile images are streamed
+    \return The map, or nullptr if it could not be loaded
+  */
+    static std::shared_ptr<Map> load(const FileInfo& folder, const std::shared_ptr<Config>& config = nullptr);
     void render(Renderer* renderer) override;
     void render_layer(Renderer* renderer, const Layer& layer);
     void think(std::shared_ptr<Game>& game);
     void activate_tile(std::shared_ptr<Game>& game, Entity* activator, LayerTile* tile);
     void activate_dialog(Entity* activator, LayerTile* tile);
-    LayerTile* intersects(const Entity* entity, const std::string& tile_type = "Collidable");
-    LayerTile* intersects(const Entity* entity, const Rect& bbox, const std::string& tile_type = "Collidable");
-    LayerTile* intersects(const Rect& bbox, const std::string& tile_type = "Collidable");
-    bool intersect_precise(const LayerTile* tile,
+    TileRef intersects(const Entity* entity, TileFlag flag = TileFlag::Collidable);
+    TileRef intersects(const Entity* entity, const Rect& bbox, TileFlag flag = TileFlag::Collidable);
+    TileRef intersects(const Rect& bbox, TileFlag flag = TileFlag::Collidable);
+    TileRef intersects(const Entity* entity, const std::string& tile_type);
+    TileRef intersects(const Entity* entity, const Rect& bbox, const std::string& tile_type);
+    TileRef intersects(const Rect& bbox, const std::string& tile_type);
+    bool intersect_precise(const TileRef& tile,
         int32_t check_x, int32_t check_y,
         const Entity* other, const Rect& this_bbox,
         bool use_entity_collision_frame);
-    LayerTile* intersect_slow(const Entity* other, const Rect& this_bbox, const std::string& tile_type = "Collidable");
-    LayerTile* intersect_slow(const Rect& this_bbox, const std::string& tile_type = "Collidable");
+    TileRef intersect_slow(const Entity* other, const Rect& this_bbox, TileFlag flag, const std::string* tile_type = nullptr);
+    TileRef intersect_slow(const Rect& this_bbox, TileFlag flag, const std::string* tile_type = nullptr);
+
+    /*!
+    Merge the tile flags of every layer into the collision grid; called once the layers are loaded
+  */
+    void build_collision_grid();
+
+    //! Merge the collision grid's flags by chunk; called whenever the whole grid is replaced
+    void build_grid_chunks();
+
+    /*!
+    Compile a map.json export into the binary format Map::load prefers, see map_format.hpp
+    \param folder - The folder holding map.json
+    \param output - Where to write the compiled map, usually map.rmap next to map.json
+    \return Whether the map could be read and written
+  */
+    static bool compile(const FileInfo& folder, const fs::path& output);
+
+    /*!
+    Split a layer into chunks and work out what each holds
+  */
+    void build_chunks(Layer& layer);
+
+    //! Recount what a layer chunk holds and how far its tiles draw
+    void refresh_chunk(Layer& layer, uint32_t chunk);
+
+    //! Merge one grid cell from every layer again, and the flags of its grid chunk
+    void refresh_grid_cell(int32_t cx, int32_t cy);
+
+    /*!
+    Put a tile in a layer cell, or empty it, and bring its chunk and grid cell up to date.
+    Once the map is being drawn, the caller must hold mutex.
+    \param layer - The layer to change
+    \param x - The cell's column
+    \param row - The cell's row, counted from the top as in the map editor
+    \param tile_index - The tile's index with the editor's flip bits, or 0 to empty the cell
+    \return Whether the tile could be placed
+  */
+    bool place_tile(Layer& layer, uint32_t x, uint32_t row, uint32_t tile_index);
+
+    /*!
+    Change a tile at runtime, such as a block breaking, by layer name. Safe
+    to call while the render thread draws the map.
+    \return Whether the layer and tile exist
+  */
+    bool set_tile(const std::string& layer_name, uint32_t x, uint32_t row, uint32_t tile_index);
+
+    //! The tile index in a cell without its flip bits, or 0 if it is empty or does not exist
+    uint32_t get_tile(const std::string& layer_name, uint32_t x, uint32_t row);
+
+    Layer* find_layer(const std::string& layer_name);
+
+    static void setup_lua_context(sol::state& state);
+
+    /*!
+    Visit every tile and object of a type whose box touches an area
+    \param area - The area to search, in world coordinates
+    \param flag - Only tiles with this flag are visited
+    \param tile_type - For TileFlag::Other, the type name the tiles must have as well
+    \param visit - Called as visit(const TileRef&, const Rect& tile_box) with the tile's box in
+      world coordinates; return false to stop early
+  */
+    template <class Visitor>
+    void for_each_tile(const Rect& area, TileFlag flag, const std::string* tile_type, Visitor&& visit)
+    {
+        const auto want = static_cast<uint8_t>(flag);
+        const auto matches = [&](uint8_t flags, const std::string& type) {
+            return (flags & want) && (!tile_type || type == *tile_type);
+        };
+
+        const double tw = tile_width;
+        const double th = tile_height;
+        const auto left = std::max(grid.x, static_cast<int32_t>(std::floor(area.x / tw)));
+        const auto right = std::min(grid.x + grid.width - 1, static_cast<int32_t>(std::floor((area.x + area.w) / tw)));
+        const auto bottom = std::max(grid.y, static_cast<int32_t>(std::floor(area.y / th)));
+        const auto top = std::min(grid.y + grid.height - 1, static_cast<int32_t>(std::floor((area.y + area.h) / th)));
+
+        for (int32_t cy = bottom; cy <= top; ++cy) {
+            const uint8_t* row = grid.cells.data() + static_cast<size_t>(cy - grid.y) * grid.width;
+            for (int32_t cx = left; cx <= right; ++cx) {
+                // Step over the rest of this chunk's row if nothing in the chunk matches
+                if (!(grid.chunk_flags[grid.chunk_of(cx, cy)] & want)) {
+                    const auto chunk_end = grid.x + static_cast<int32_t>(((cx - grid.x) / TileChunkSize + 1) * TileChunkSize);
+                    cx = chunk_end - 1;
+                    continue;
+                }
+
+                if (!(row[cx - grid.x] & want)) {
+                    continue;
+                }
+
+                // Only cells some layer marked are resolved to their tiles
+                for (auto& layer : layers) {
+                    const auto x = cx - layer.x;
+                    const auto y = cy - layer.y;
+                    if (x < 0 || y < 0 || x >= static_cast<int32_t>(layer.width) || y >= static_cast<int32_t>(layer.height)) {
+                        continue;
+                    }
+
+                    const auto idx = (layer.height - y - 1) * layer.width + x;
+                    const auto& cell = layer.cells[idx];
+                    if (cell.gid == 0 || !matches(cell.flag, tilemap[cell.gid].type)) {
+                        continue;
+                    }
+
+                    const auto tile = layer.tile_at(tilemap, idx);
+
+                    if (!visit(tile, Rect(cx * tw, cy * th, tw, th))) {
+                        return;
+                    }
+                }
+            }
+        }
+
+        for (auto& obj : objects) {
+            if (!matches(static_cast<uint8_t>(obj.flag), obj.type)) {
+                continue;
+            }
+
+            const Rect box(obj.dst.x, obj.dst.y, obj.dst.w, obj.dst.h);
+            if (box.x > area.x + area.w || area.x > box.x + box.w || box.y > area.y + area.h || area.y > box.y + box.h) {
+                continue;
+            }
+
+            TileRef ref;
+            ref.placed = &obj;
+            ref.flip_x = obj.flip_x;
+            ref.flip_y = obj.flip_y;
+            if (!visit(ref, box)) {
+                return;
+            }
+        }
+    }
+
+    template <class Visitor>
+    void for_each_tile(const Rect& area, TileFlag flag, Visitor&& visit)
+    {
+        this->for_each_tile(area, flag, nullptr, std::forward<Visitor>(visit));
+    }
+
+    template <class Visitor>
+    void for_each_tile(const Rect& area, const std::string& tile_type, Visitor&& visit)
+    {
+        const auto flag = tile_flag_from_type(tile_type);
+        this->for_each_tile(area, flag, flag == TileFlag::Other ? &tile_type : nullptr, std::forward<Visitor>(visit));
+    }
 
 public:
     std::string name;
@@ -85,6 +416,15 @@ public:
     std::vector<Layer> layers;
     std::vector<LayerTile> objects;
     std::vector<Tile> tilemap;
+
+    //! Every layer's tile flags, merged by cell
+    CollisionGrid grid;
+
+    //! Loads tile images around the players, if the map streams
+    std::unique_ptr<MapStreamer> streamer;
+
+    //! Held while the layers are drawn and while tiles are edited, so the render thread never sees half an edit
+    std::mutex mutex;
     std::shared_ptr<Dialog> active_dialog;
     uint32_t width, height;
     uint32_t tile_width, tile_height;
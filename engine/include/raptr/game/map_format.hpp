@@ -0,0 +1,89 @@
+/*!
+  \file map_format.hpp
+  The layout of a compiled map (map.rmap), written by raptr-mapc from a
+  map.json export. Everything is fixed-size records at byte offsets from the
+  start of the file, so a loader can map the file and read the tables in
+  place instead of parsing text:
+
+    CompiledMapHeader
+    strings     - NUL terminated, referenced by byte offset
+    tiles       - a CompiledTile for every tile id up to the largest used
+    layers      - a CompiledLayer for every tile layer
+    cells       - each layer's TileCells, row-major from the top row
+    objects     - string offsets of each map object's JSON
+    grid        - the merged collision grid, one byte per cell
+    sources     - string offsets of the tilesets and images read while compiling,
+                  relative to the game root, so edits to them are noticed
+
+  Sections start on 8-byte boundaries. The byte order of the machine that
+  wrote the file is recorded and a mismatch is rejected rather than swapped.
+*/
+#pragma once
+
+#include <cstdint>
+
+namespace raptr {
+
+//! "RMAP" as it reads in a hex dump
+const uint32_t CompiledMapMagic = 0x50414d52;
+
+//! Bumped whenever a record changes; older files are ignored in favor of map.json
+const uint32_t CompiledMapVersion = 2;
+
+//! Written as a native integer, so it only reads back the same on a machine of the same byte order
+const uint32_t CompiledMapByteOrder = 0x01020304;
+
+//! A string offset that refers to no string
+const uint32_t CompiledMapNoString = 0xffffffff;
+
+struct CompiledSection {
+    uint64_t offset;
+    uint64_t size;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+struct CompiledMapHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t width, height;
+    uint32_t tile_width, tile_height;
+    uint32_t reserved;
+    double spawn_x, spawn_y;
+
+    CompiledSection strings;
+    CompiledSection tiles;
+    CompiledSection layers;
+    CompiledSection objects;
+    CompiledSection grid;
+    int32_t grid_x, grid_y;
+    int32_t grid_width, grid_height;
+    CompiledSection sources;
+};
+
+struct CompiledTile {
+    //! The image, relative to the game root, or none for sprite tiles
+    uint32_t image;
+
+    //! The tile type from the editor
+    uint32_t type;
+
+    //! The sprite json, relative to the game root, for animated tiles
+    uint32_t animation;
+
+    //! The image size in pixels, so streamed tiles need not be decoded
+    int32_t width, height;
+};
+
+struct CompiledLayer {
+    uint32_t name;
+    int32_t x, y;
+    uint32_t width, height;
+    uint32_t reserved;
+
+    //! Where the layer's width * height TileCells start
+    uint64_t cells_offset;
+};
+
+} // namespace raptr
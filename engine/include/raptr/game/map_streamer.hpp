@@ -0,0 +1,127 @@
+/*!
+  \file map_streamer.hpp
+  Streams tile images in and out around the players. A map that streams
+  keeps every layer's cells, but only decodes the images of tiles used by the
+  chunks near a player or the camera. Decoding and building collision masks
+  happens on a background thread; textures are created on the render thread a
+  few per frame; chunks are only evicted once they are well past the load
+  radius so standing at the edge does not thrash.
+*/
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <SDL.h>
+
+#include <raptr/common/bitmask.hpp>
+#include <raptr/common/rect.hpp>
+
+namespace raptr {
+
+class Config;
+class Map;
+class Renderer;
+struct Layer;
+
+class MapStreamer {
+public:
+    /*!
+    Start the loading thread for a map whose tilemap has been sized
+    \param map - The map whose tiles are streamed; it must outlive the streamer
+    \param config - Where the radii and upload budget come from
+  */
+    MapStreamer(Map& map, const Config& config);
+    ~MapStreamer();
+
+    MapStreamer(const MapStreamer&) = delete;
+    MapStreamer& operator=(const MapStreamer&) = delete;
+
+    /*!
+    Load chunks that came within range of a focus, evict those that moved past the
+    hysteresis radius and hand finished images to the map. Runs on the game thread
+    and holds the map's mutex while chunks change, so it must not be held already.
+    \param foci - The boxes of every player and the camera
+  */
+    void update(const std::vector<Bounds>& foci);
+
+    /*!
+    Create or destroy the textures of tiles that were loaded or evicted, at most the
+    configured number per frame. Runs on the render thread.
+  */
+    void upload(Renderer* renderer);
+
+    //! A resident cell started using a tile
+    void retain(uint32_t gid);
+
+    //! A resident cell stopped using a tile
+    void release(uint32_t gid);
+
+    //! How many layer chunks are resident
+    size_t resident_chunks() const
+    {
+        return resident_count;
+    }
+
+    //! How many streamed tiles have their image loaded
+    size_t loaded_tiles() const
+    {
+        return loaded_count;
+    }
+
+private:
+    enum class TileState : uint8_t {
+        Unloaded,
+        Loading,
+        Loaded
+    };
+
+    //! An image decoded by the loading thread
+    struct Decoded {
+        uint32_t gid;
+        std::shared_ptr<SDL_Surface> surface;
+        std::shared_ptr<const CollisionMasks> masks;
+    };
+
+    //! A texture to create from surface, or to destroy if there is no surface
+    struct Upload {
+        uint32_t gid;
+        std::shared_ptr<SDL_Surface> surface;
+    };
+
+    void worker_loop();
+    void apply_decoded();
+    void load_chunk(Layer& layer, uint32_t chunk);
+    void evict_chunk(Layer& layer, uint32_t chunk);
+
+    Map& map;
+    double load_radius;
+    double evict_radius;
+    int32_t uploads_per_frame;
+
+    //! How many resident cells use each tile, and whether its image is loaded; game thread only
+    std::vector<uint32_t> users;
+    std::vector<TileState> state;
+    size_t resident_count = 0;
+    size_t loaded_count = 0;
+
+    //! Images waiting to be decoded and those that have been, shared with the loading thread
+    std::mutex load_mutex;
+    std::condition_variable load_wake;
+    std::deque<std::pair<uint32_t, std::string>> requests;
+    std::vector<Decoded> decoded;
+    bool stopping = false;
+    std::thread worker;
+
+    //! Textures for the render thread to create or destroy, in the order they were asked for
+    std::mutex upload_mutex;
+    std::deque<Upload> uploads;
+};
+
+} // namespace raptr
@@ -58,7 +58,8 @@ public:
     void render(Renderer* renderer) override;
 
 public:
-    std::map<std::array<unsigned char, 16>, std::shared_ptr<Character>> tracking;
+    //! The characters currently inside the trigger
+    std::vector<EntityHandle> tracking;
     TriggerCallback on_enter;
     TriggerCallback on_exit;
     Rect shape;
@@ -6,6 +6,7 @@
 #include <memory>
 #include <string>
 #include <type_traits>
+#include <variant>
 #include <vector>
 
 #include <raptr/common/clock.hpp>
@@ -31,23 +32,13 @@ enum class NetFieldType {
     Map,
 };
 
-enum class EngineEventType {
-    ControllerEvent,
-    SpawnCharacter,
-    SpawnActor,
-    SpawnTrigger,
-    LoadMap,
-};
-
 struct ControllerEvent {
-    static const EngineEventType event_type = EngineEventType::ControllerEvent;
     int32_t controller_id;
     SDL_Event sdl_event;
 };
 
 struct CharacterSpawnEvent {
     typedef std::function<void(std::shared_ptr<Character>&)> Callback;
-    static const EngineEventType event_type = EngineEventType::SpawnCharacter;
     std::string path;
     int32_t controller_id;
     GUID guid;
@@ -56,7 +47,6 @@ struct CharacterSpawnEvent {
 
 struct ActorSpawnEvent {
     typedef std::function<void(std::shared_ptr<Actor>&)> Callback;
-    static const EngineEventType event_type = EngineEventType::SpawnActor;
     std::string path;
     GUID guid;
     Callback callback;
@@ -64,7 +54,6 @@ struct ActorSpawnEvent {
 
 struct TriggerSpawnEvent {
     typedef std::function<void(std::shared_ptr<Trigger>&)> Callback;
-    static const EngineEventType event_type = EngineEventType::SpawnTrigger;
     Rect rect;
     GUID guid;
     Callback callback;
@@ -72,25 +61,21 @@ struct TriggerSpawnEvent {
 
 struct LoadMapEvent {
     typedef std::function<void(std::shared_ptr<Map>&)> Callback;
-    static const EngineEventType event_type = EngineEventType::LoadMap;
     std::string name;
     Callback callback;
 };
 
+//! Every event the engine knows how to dispatch, stored inline in the event ring
+using EngineEventData = std::variant<
+    ControllerEvent,
+    CharacterSpawnEvent,
+    ActorSpawnEvent,
+    TriggerSpawnEvent,
+    LoadMapEvent>;
+
 struct EngineEvent {
-    EngineEventType type;
     int64_t time;
-    void* data;
-
-    template <class T>
-    static std::shared_ptr<EngineEvent> create(T* data_)
-    {
-        auto event = std::make_shared<EngineEvent>();
-        event->data = (void*)(data_);
-        event->type = T::event_type;
-        event->time = clock::ticks();
-        return event;
-    }
+    EngineEventData data;
 };
 
 struct NetField {
@@ -3,6 +3,7 @@
 #include <SDL_rect.h>
 #include <memory>
 #include <raptr/common/rect.hpp>
+#include <raptr/game/entity_handle.hpp>
 #include <vector>
 
 namespace raptr {
@@ -38,7 +39,7 @@ class Camera {
 public:
     Camera() = default;
     Camera(Point center, int32_t w, int32_t h);
-    void track(std::shared_ptr<Entity> entity);
+    void track(EntityHandle entity);
     void set_min_size(int32_t w, int32_t h);
     void update_constraints();
     void think(Renderer* renderer, uint64_t delta_us);
@@ -46,7 +47,12 @@ public:
     void render(Renderer* renderer, const CameraClip& clip);
 
 public:
-    std::vector<std::shared_ptr<Entity>> tracking;
+    //! The entities the camera follows. Stale handles are dropped on the next think.
+    std::vector<EntityHandle> tracking;
+
+    //! The game's entity slots that tracking resolves against
+    const EntitySlots* entities = nullptr;
+
     Point trap_size;
     Rect min_size;
     std::vector<CameraClip> clips;
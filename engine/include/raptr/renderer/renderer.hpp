@@ -219,6 +219,13 @@ public:
   */
     SDL_Texture* create_texture(std::shared_ptr<SDL_Surface>& surface);
 
+    /*!
+    Drop a reference to a surface that has been uploaded, unless the configuration keeps surfaces.
+    The memory is counted towards surface_bytes_released when the last reference goes.
+    /param surface - The surface to release; left untouched if surfaces are kept
+  */
+    void release_surface(std::shared_ptr<SDL_Surface>& surface);
+
     /*!
     Initialize the renderer from a Configuration file
     /param config_ - The configuration that will be used to pull rendering parameters
@@ -250,13 +257,19 @@ public:
 
     //! The configuration that was used to create this Renderer
     std::shared_ptr<Config> config;
-    std::shared_ptr<Text> fps_text, num_obj_rendered_text, mempool_text;
+    std::shared_ptr<Text> fps_text, num_obj_rendered_text, mempool_text, surfaces_text;
+
+    //! Bytes of image memory freed by dropping surfaces after their textures were uploaded
+    uint64_t surface_bytes_released = 0;
 
     //! How many frames have been rendered
     uint64_t total_frames_rendered;
     uint64_t fps;
     uint64_t last_render_time_us;
 
+    //! How far between simulation ticks this frame is drawn, used for interpolation
+    double sim_alpha;
+
     //! Camera position
     CameraBasic camera_basic;
     Camera camera;
@@ -15,6 +15,7 @@
 #include <SDL.h>
 #include <SDL_surface.h>
 
+#include <raptr/common/bitmask.hpp>
 #include <raptr/common/filesystem.hpp>
 
 namespace raptr {
@@ -38,6 +39,9 @@ struct AnimationFrame {
 
     bool has_sound_effect;
     FileInfo sound_effect;
+
+    //! Which pixels of the frame are solid, packed when the sprite is loaded
+    std::shared_ptr<const CollisionMasks> masks;
 };
 
 /*!
@@ -96,6 +100,16 @@ public:
   */
     bool next(int64_t clock_us, double speed_multiplier = 1.0);
 
+    /*!
+    Step through as many frames as the elapsed time covers, rather than at most
+    one. Used to catch up an animation that has not been rendered for a while,
+    so no sound effects are played.
+    /param elapsed_us - How long it has been since the current frame started
+    /param speed_multiplier - Play animations faster
+    /return How far into the new current frame the elapsed time reaches
+  */
+    int64_t advance(int64_t elapsed_us, double speed_multiplier = 1.0);
+
     /*!
     Register a sound effect that plays with an animation
     /param name - The animation to register against
@@ -104,6 +118,10 @@ public:
     when the animation has changed
   */
     bool register_sound_effect(int32_t frame, FileInfo wav, bool do_loop);
+
+private:
+    //! Move to the next frame according to the animation direction
+    void step();
 };
 
 //! A mapping of Animation names to the Animation themselves
@@ -133,6 +151,12 @@ public:
   */
     void render(Renderer* renderer);
 
+    /*!
+    Bring the current animation up to the present after a stretch of not
+    being rendered, as if it had been playing the whole time
+  */
+    void catch_up();
+
     /*!
     Change the current animation to a different one by name, such as "Idle" or "Walk"
     /param name - The name of the animation, such as "Idle" or "Walk"
@@ -166,9 +190,12 @@ public:
     //! The width and height of the Spritesheet
     int32_t width, height;
 
-    //! The constructed SDL_Surface from the spritesheet
+    //! The constructed SDL_Surface from the spritesheet, dropped after upload unless surfaces are kept
     std::shared_ptr<SDL_Surface> surface;
 
+    //! Where the spritesheet image was loaded from, which also keys its shared texture
+    fs::path sheet_path;
+
     //! The constructed SDL_Texture from the SDL_Surface of the spritesheet
     std::shared_ptr<SDL_Texture> texture;
 
@@ -0,0 +1,207 @@
+#include <algorithm>
+
+#include <raptr/common/bitmask.hpp>
+
+// Narrow masks are tested several rows at a time where the target allows it
+#if defined(__AVX2__)
+#define BITMASK_USE_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BITMASK_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+//! The bits of a word starting at column base that fall in columns [x0, x1)
+uint64_t range_mask(int32_t base, int32_t x0, int32_t x1)
+{
+    const auto lo = std::max(x0 - base, 0);
+    const auto hi = std::min(x1 - base, 64);
+    if (lo >= hi) {
+        return 0;
+    }
+
+    const auto below_hi = hi == 64 ? ~0ull : ((1ull << hi) - 1);
+    return below_hi & ~((1ull << lo) - 1);
+}
+};
+
+namespace raptr {
+
+Bitmask Bitmask::from_pixels(const uint8_t* pixels, int32_t pitch, int32_t bytes_per_pixel,
+    int32_t width, int32_t height, bool flip_x, bool flip_y)
+{
+    Bitmask mask;
+    if (width <= 0 || height <= 0) {
+        return mask;
+    }
+
+    mask.w = width;
+    mask.h = height;
+    mask.words = (width + 63) / 64;
+    mask.rows.assign(static_cast<size_t>(mask.words) * height, 0);
+
+    int64_t solid = 0;
+    for (int32_t y = 0; y < height; ++y) {
+        const auto src_y = flip_y ? y : height - 1 - y;
+        const uint8_t* src_row = pixels + static_cast<ptrdiff_t>(src_y) * pitch;
+        uint64_t* row = &mask.rows[static_cast<size_t>(y) * mask.words];
+
+        for (int32_t x = 0; x < width; ++x) {
+            const auto src_x = flip_x ? width - 1 - x : x;
+            if (src_row[src_x * bytes_per_pixel] > 0) {
+                row[x >> 6] |= 1ull << (x & 63);
+                ++solid;
+            }
+        }
+    }
+
+    mask.is_empty = solid == 0;
+    mask.is_opaque = solid == static_cast<int64_t>(width) * height;
+    return mask;
+}
+
+uint64_t Bitmask::bits_at(int32_t y, int32_t x) const
+{
+    const auto word = (x >= 0 ? x : x - 63) / 64;
+    const auto shift = x - word * 64;
+    const uint64_t* row = &rows[static_cast<size_t>(y) * words];
+
+    const auto get = [&](int32_t k) -> uint64_t {
+        return k >= 0 && k < words ? row[k] : 0;
+    };
+
+    const auto lo = get(word) >> shift;
+    const auto hi = shift ? get(word + 1) << (64 - shift) : 0;
+    return lo | hi;
+}
+
+bool Bitmask::test(int32_t x, int32_t y) const
+{
+    if (x < 0 || y < 0 || x >= w || y >= h) {
+        return false;
+    }
+    return (rows[static_cast<size_t>(y) * words + (x >> 6)] >> (x & 63)) & 1;
+}
+
+bool Bitmask::any(int32_t x0, int32_t y0, int32_t x1, int32_t y1) const
+{
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, w);
+    y1 = std::min(y1, h);
+    if (x0 >= x1 || y0 >= y1 || is_empty) {
+        return false;
+    }
+
+    if (is_opaque) {
+        return true;
+    }
+
+    const auto k0 = x0 >> 6;
+    const auto k1 = (x1 - 1) >> 6;
+    for (int32_t y = y0; y < y1; ++y) {
+        const uint64_t* row = &rows[static_cast<size_t>(y) * words];
+        for (auto k = k0; k <= k1; ++k) {
+            if (row[k] & range_mask(k * 64, x0, x1)) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool Bitmask::overlaps(const Bitmask& other, int32_t dx, int32_t dy) const
+{
+    const auto x0 = std::max(0, dx);
+    const auto x1 = std::min(w, dx + other.w);
+    const auto y0 = std::max(0, dy);
+    const auto y1 = std::min(h, dy + other.h);
+    if (x0 >= x1 || y0 >= y1 || is_empty || other.is_empty) {
+        return false;
+    }
+
+    // A solid mask only needs the other to have something inside the overlap
+    if (is_opaque) {
+        return other.any(x0 - dx, y0 - dy, x1 - dx, y1 - dy);
+    }
+    if (other.is_opaque) {
+        return this->any(x0, y0, x1, y1);
+    }
+
+    if (words == 1 && other.words == 1) {
+        return this->overlaps_narrow(other, dx, x0, x1, y0, y1, dy);
+    }
+
+    const auto k0 = x0 >> 6;
+    const auto k1 = (x1 - 1) >> 6;
+    for (int32_t y = y0; y < y1; ++y) {
+        const uint64_t* row = &rows[static_cast<size_t>(y) * words];
+        for (auto k = k0; k <= k1; ++k) {
+            const auto mine = row[k] & range_mask(k * 64, x0, x1);
+            if (mine && (mine & other.bits_at(y - dy, k * 64 - dx))) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool Bitmask::overlaps_narrow(const Bitmask& other, int32_t dx, int32_t x0, int32_t x1, int32_t y0, int32_t y1, int32_t dy) const
+{
+    // Both masks are one word per row, so other's rows line up with ours after a single shift
+    const auto mask = range_mask(0, x0, x1);
+    const uint64_t* mine = rows.data();
+    const uint64_t* theirs = other.rows.data() - dy;
+    int32_t y = y0;
+
+#if defined(BITMASK_USE_AVX2)
+    const __m256i range = _mm256_set1_epi64x(static_cast<int64_t>(mask));
+    const __m128i count = _mm_cvtsi32_si128(dx >= 0 ? dx : -dx);
+    for (; y + 4 <= y1; y += 4) {
+        const auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mine + y));
+        auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(theirs + y));
+        b = dx >= 0 ? _mm256_sll_epi64(b, count) : _mm256_srl_epi64(b, count);
+        const auto hit = _mm256_and_si256(_mm256_and_si256(a, b), range);
+        if (!_mm256_testz_si256(hit, hit)) {
+            return true;
+        }
+    }
+#elif defined(BITMASK_USE_SSE2)
+    const __m128i range = _mm_set1_epi64x(static_cast<int64_t>(mask));
+    const __m128i count = _mm_cvtsi32_si128(dx >= 0 ? dx : -dx);
+    const __m128i zero = _mm_setzero_si128();
+    for (; y + 2 <= y1; y += 2) {
+        const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mine + y));
+        auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(theirs + y));
+        b = dx >= 0 ? _mm_sll_epi64(b, count) : _mm_srl_epi64(b, count);
+        const auto hit = _mm_and_si128(_mm_and_si128(a, b), range);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(hit, zero)) != 0xffff) {
+            return true;
+        }
+    }
+#endif
+
+    for (; y < y1; ++y) {
+        const auto shifted = dx >= 0 ? theirs[y] << dx : theirs[y] >> -dx;
+        if (mine[y] & shifted & mask) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::shared_ptr<const CollisionMasks> CollisionMasks::from_pixels(const uint8_t* pixels, int32_t pitch,
+    int32_t bytes_per_pixel, int32_t width, int32_t height)
+{
+    auto masks = std::make_shared<CollisionMasks>();
+    for (int32_t i = 0; i < 4; ++i) {
+        masks->variants[i] = Bitmask::from_pixels(pixels, pitch, bytes_per_pixel, width, height, (i & 1) != 0, (i & 2) != 0);
+    }
+    return masks;
+}
+
+} // namespace raptr
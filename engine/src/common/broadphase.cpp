@@ -0,0 +1,321 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include <raptr/common/broadphase.hpp>
+#include <raptr/common/logging.hpp>
+
+namespace {
+auto logger = raptr::_get_logger(__FILE__);
+};
+
+namespace raptr {
+
+std::unique_ptr<Broadphase> Broadphase::create(const std::string& kind, double cell_size)
+{
+    if (kind == "rtree") {
+        return std::make_unique<RTreeBroadphase>();
+    }
+
+    if (kind == "hash") {
+        if (cell_size <= 0) {
+            logger->error("{} is not a valid spatial hash cell size", cell_size);
+            return nullptr;
+        }
+        return std::make_unique<SpatialHashBroadphase>(cell_size);
+    }
+
+    logger->error("{} is not a known broadphase, expected rtree or hash", kind);
+    return nullptr;
+}
+
+void Broadphase::insert_batch(const std::vector<BroadphaseEntry>& entries)
+{
+    for (const auto& entry : entries) {
+        this->insert(entry.handle, entry.bounds, entry.tag);
+    }
+}
+
+void RTreeBroadphase::insert(SlotHandle handle, const Bounds& bounds, const BroadphaseTag& tag)
+{
+    tree.Insert(bounds.min, bounds.max, Item::make(handle, tag));
+    ++count;
+}
+
+void RTreeBroadphase::insert_batch(const std::vector<BroadphaseEntry>& entries)
+{
+    // A batch much smaller than the tree is cheaper to insert than to repack everything
+    if (entries.size() * 4 < count) {
+        Broadphase::insert_batch(entries);
+        return;
+    }
+
+    std::vector<Tree::Entry> packed;
+    packed.reserve(count + entries.size());
+
+    Tree::Iterator it;
+    for (tree.GetFirst(it); !Tree::IsNull(it); Tree::GetNext(it)) {
+        Tree::Entry entry;
+        it.GetBounds(entry.m_min, entry.m_max);
+        entry.m_data = *it;
+        packed.push_back(entry);
+    }
+
+    for (const auto& entry : entries) {
+        Tree::Entry e;
+        e.m_min[0] = entry.bounds.min[0];
+        e.m_min[1] = entry.bounds.min[1];
+        e.m_max[0] = entry.bounds.max[0];
+        e.m_max[1] = entry.bounds.max[1];
+        e.m_data = Item::make(entry.handle, entry.tag);
+        packed.push_back(e);
+    }
+
+    tree.BulkLoad(packed);
+    count = packed.size();
+}
+
+void RTreeBroadphase::remove(SlotHandle handle, const Bounds& bounds)
+{
+    auto item = Item::make(handle, {});
+    if (tree.Take(bounds.min, bounds.max, item)) {
+        --count;
+    }
+}
+
+void RTreeBroadphase::move(SlotHandle handle, const Bounds& from, const Bounds& to)
+{
+    // The tag has to survive the move, so take back what the tree held
+    auto item = Item::make(handle, {});
+    if (!tree.Take(from.min, from.max, item)) {
+        assert(false && "Moved a handle the broadphase does not hold");
+        return;
+    }
+    tree.Insert(to.min, to.max, item);
+}
+
+void RTreeBroadphase::retag(SlotHandle handle, const Bounds& bounds, const BroadphaseTag& tag)
+{
+    auto item = Item::make(handle, {});
+    if (!tree.Take(bounds.min, bounds.max, item)) {
+        assert(false && "Retagged a handle the broadphase does not hold");
+        return;
+    }
+    tree.Insert(bounds.min, bounds.max, Item::make(handle, tag));
+}
+
+size_t RTreeBroadphase::query(const Bounds& bounds, const BroadphaseFilter* filter, BroadphaseCallback callback, void* context) const
+{
+    struct Forward {
+        const BroadphaseFilter* filter;
+        BroadphaseCallback callback;
+        void* context;
+        size_t reported;
+    } forward { filter, callback, context, 0 };
+
+    tree.Search(bounds.min, bounds.max, [](Item item, void* forward_context) -> bool {
+        const auto forward = reinterpret_cast<Forward*>(forward_context);
+        if (forward->filter && !filter_accepts(*forward->filter, item.tag())) {
+            return true;
+        }
+        ++forward->reported;
+        return forward->callback(item.handle, forward->context);
+    },
+        &forward);
+
+    return forward.reported;
+}
+
+void RTreeBroadphase::clear()
+{
+    tree.RemoveAll();
+    count = 0;
+}
+
+size_t RTreeBroadphase::size() const
+{
+    return count;
+}
+
+const char* RTreeBroadphase::name() const
+{
+    return "rtree";
+}
+
+SpatialHashBroadphase::SpatialHashBroadphase(double cell_size)
+    : cell(cell_size)
+    , inv_cell(1.0 / cell_size)
+{
+}
+
+SpatialHashBroadphase::CellRange SpatialHashBroadphase::cells_for(const Bounds& bounds) const
+{
+    return {
+        static_cast<int32_t>(std::floor(bounds.min[0] * inv_cell)),
+        static_cast<int32_t>(std::floor(bounds.min[1] * inv_cell)),
+        static_cast<int32_t>(std::floor(bounds.max[0] * inv_cell)),
+        static_cast<int32_t>(std::floor(bounds.max[1] * inv_cell)),
+    };
+}
+
+uint64_t SpatialHashBroadphase::key(int32_t x, int32_t y)
+{
+    return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+}
+
+void SpatialHashBroadphase::add(SlotHandle handle, const CellRange& range)
+{
+    for (int32_t x = range.x0; x <= range.x1; ++x) {
+        for (int32_t y = range.y0; y <= range.y1; ++y) {
+            cells[key(x, y)].push_back(handle);
+        }
+    }
+}
+
+bool SpatialHashBroadphase::drop(SlotHandle handle, const CellRange& range)
+{
+    bool dropped = false;
+    for (int32_t x = range.x0; x <= range.x1; ++x) {
+        for (int32_t y = range.y0; y <= range.y1; ++y) {
+            const auto found = cells.find(key(x, y));
+            if (found == cells.end()) {
+                continue;
+            }
+
+            // Cells are small, so a linear search and a swap-and-pop is enough
+            auto& entries = found->second;
+            const auto it = std::find(entries.begin(), entries.end(), handle);
+            if (it != entries.end()) {
+                *it = entries.back();
+                entries.pop_back();
+                dropped = true;
+            }
+
+            // Empty cells are erased, or the table would grow with every cell an entity passed through
+            if (entries.empty()) {
+                cells.erase(found);
+            }
+        }
+    }
+    return dropped;
+}
+
+void SpatialHashBroadphase::insert(SlotHandle handle, const Bounds& bounds, const BroadphaseTag& tag)
+{
+    const auto index = handle.index();
+    if (index >= boxes.size()) {
+        boxes.resize(index + 1);
+    }
+
+    boxes[index] = { bounds, tag };
+    this->add(handle, this->cells_for(bounds));
+    ++count;
+}
+
+void SpatialHashBroadphase::remove(SlotHandle handle, const Bounds& bounds)
+{
+    if (this->drop(handle, this->cells_for(bounds))) {
+        --count;
+    }
+}
+
+void SpatialHashBroadphase::move(SlotHandle handle, const Bounds& from, const Bounds& to)
+{
+    boxes[handle.index()].bounds = to;
+
+    const auto old_range = this->cells_for(from);
+    const auto new_range = this->cells_for(to);
+    if (old_range == new_range) {
+        return;
+    }
+
+    this->drop(handle, old_range);
+    this->add(handle, new_range);
+}
+
+void SpatialHashBroadphase::retag(SlotHandle handle, const Bounds&, const BroadphaseTag& tag)
+{
+    boxes[handle.index()].tag = tag;
+}
+
+size_t SpatialHashBroadphase::query(const Bounds& bounds, const BroadphaseFilter* filter, BroadphaseCallback callback, void* context) const
+{
+    const auto range = this->cells_for(bounds);
+    size_t found = 0;
+
+    // An entry that spans several cells is only reported from the first cell
+    // it shares with the query, so no visited set is needed and concurrent
+    // queries stay read-only.
+    const auto visit = [&](int32_t x, int32_t y, const std::vector<SlotHandle>& entries) {
+        for (const auto handle : entries) {
+            const auto& box = boxes[handle.index()];
+            if (filter && !filter_accepts(*filter, box.tag)) {
+                continue;
+            }
+            if (!bounds_overlap(box.bounds, bounds)) {
+                continue;
+            }
+
+            const auto own = this->cells_for(box.bounds);
+            if (x != std::max(own.x0, range.x0) || y != std::max(own.y0, range.y0)) {
+                continue;
+            }
+
+            ++found;
+            if (!callback(handle, context)) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    const auto span = static_cast<uint64_t>(range.x1 - range.x0 + 1) * static_cast<uint64_t>(range.y1 - range.y0 + 1);
+
+    // Huge queries over a sparse world walk the occupied cells instead
+    if (span > cells.size()) {
+        for (const auto& pair : cells) {
+            const auto x = static_cast<int32_t>(static_cast<uint32_t>(pair.first >> 32));
+            const auto y = static_cast<int32_t>(static_cast<uint32_t>(pair.first & 0xffffffffu));
+            if (x < range.x0 || x > range.x1 || y < range.y0 || y > range.y1) {
+                continue;
+            }
+            if (!visit(x, y, pair.second)) {
+                break;
+            }
+        }
+        return found;
+    }
+
+    for (int32_t x = range.x0; x <= range.x1; ++x) {
+        for (int32_t y = range.y0; y <= range.y1; ++y) {
+            const auto cell_entries = cells.find(key(x, y));
+            if (cell_entries == cells.end()) {
+                continue;
+            }
+            if (!visit(x, y, cell_entries->second)) {
+                return found;
+            }
+        }
+    }
+
+    return found;
+}
+
+void SpatialHashBroadphase::clear()
+{
+    cells.clear();
+    boxes.clear();
+    count = 0;
+}
+
+size_t SpatialHashBroadphase::size() const
+{
+    return count;
+}
+
+const char* SpatialHashBroadphase::name() const
+{
+    return "hash";
+}
+
+} // namespace raptr
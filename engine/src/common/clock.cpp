@@ -1,3 +1,4 @@
+#include <atomic>
 #include <chrono>
 #include <raptr/common/clock.hpp>
 #include <raptr/common/logging.hpp>
@@ -13,10 +14,11 @@ auto clock_last = Time::now();
 auto paused_time = Time::now();
 int64_t offset_us = 0;
 bool paused = false;
+std::atomic<bool> virtual_enabled { false };
+std::atomic<int64_t> virtual_us { 0 };
 using us = std::chrono::microseconds;
-}
 
-int64_t ticks()
+int64_t wall_ticks()
 {
     auto now = Time::now();
     if (paused) {
@@ -24,6 +26,42 @@ int64_t ticks()
     }
     return std::chrono::duration_cast<us>(now - clock_last - us(offset_us)).count();
 }
+}
+
+int64_t ticks()
+{
+    if (virtual_enabled) {
+        return virtual_us;
+    }
+    return wall_ticks();
+}
+
+void set_virtual(bool enabled)
+{
+    if (enabled == virtual_enabled) {
+        return;
+    }
+
+    if (enabled) {
+        virtual_us = wall_ticks();
+    } else {
+        // Shift the wall clock so that time does not jump backwards
+        offset_us += wall_ticks() - virtual_us;
+    }
+    virtual_enabled = enabled;
+}
+
+bool is_virtual()
+{
+    return virtual_enabled;
+}
+
+void advance(int64_t delta_us)
+{
+    if (virtual_enabled) {
+        virtual_us += delta_us;
+    }
+}
 
 void start()
 {
@@ -0,0 +1,156 @@
+#include <cstring>
+#include <limits>
+
+#include <zlib.h>
+#if defined(RAPTR_WITH_ZSTD)
+#include <zstd.h>
+#endif
+
+#include <raptr/common/compression.hpp>
+#include <raptr/common/logging.hpp>
+
+namespace {
+auto logger = raptr::_get_logger(__FILE__);
+
+//! The value of each base64 character, 64 for padding and 255 for anything else
+struct Base64Table {
+    Base64Table()
+    {
+        std::memset(values, 255, sizeof(values));
+        const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (uint8_t i = 0; i < 64; ++i) {
+            values[static_cast<uint8_t>(alphabet[i])] = i;
+        }
+        values[static_cast<uint8_t>('=')] = 64;
+    }
+
+    uint8_t values[256];
+};
+
+bool inflate_bytes(const uint8_t* in, size_t in_size, uint8_t* out, size_t out_size, int window_bits)
+{
+    if (in_size > std::numeric_limits<uInt>::max() || out_size > std::numeric_limits<uInt>::max()) {
+        logger->error("{} compressed bytes are too many to inflate at once", in_size);
+        return false;
+    }
+
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, window_bits) != Z_OK) {
+        logger->error("Could not start inflating: {}", stream.msg ? stream.msg : "unknown error");
+        return false;
+    }
+
+    stream.next_in = const_cast<Bytef*>(in);
+    stream.avail_in = static_cast<uInt>(in_size);
+    stream.next_out = out;
+    stream.avail_out = static_cast<uInt>(out_size);
+
+    // Everything fits in the output, so a single call must reach the end of the stream
+    const auto result = inflate(&stream, Z_FINISH);
+    const auto written = stream.total_out;
+    inflateEnd(&stream);
+
+    if (result != Z_STREAM_END || written != out_size) {
+        logger->error("Inflating gave {} of {} bytes ({})", written, out_size, result);
+        return false;
+    }
+    return true;
+}
+};
+
+namespace raptr {
+
+bool compression_from_name(const std::string& name, Compression& compression)
+{
+    if (name.empty()) {
+        compression = Compression::None;
+    } else if (name == "zlib") {
+        compression = Compression::Zlib;
+    } else if (name == "gzip") {
+        compression = Compression::Gzip;
+    } else if (name == "zstd") {
+        compression = Compression::Zstd;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool base64_decode(const std::string& text, std::vector<uint8_t>& out)
+{
+    static const Base64Table table;
+
+    out.clear();
+    out.reserve(text.size() / 4 * 3);
+
+    uint32_t quad = 0;
+    int32_t have = 0;
+    int32_t padding = 0;
+    for (const auto c : text) {
+        if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+            continue;
+        }
+
+        const auto value = table.values[static_cast<uint8_t>(c)];
+        if (value == 255 || (padding > 0 && value != 64)) {
+            return false;
+        }
+        if (value == 64) {
+            // Padding may only fill the last one or two places of a group
+            if (have < 2) {
+                return false;
+            }
+            ++padding;
+        }
+
+        quad = (quad << 6) | (value == 64 ? 0 : value);
+        if (++have == 4) {
+            out.push_back(static_cast<uint8_t>(quad >> 16));
+            if (padding < 2) {
+                out.push_back(static_cast<uint8_t>(quad >> 8));
+            }
+            if (padding < 1) {
+                out.push_back(static_cast<uint8_t>(quad));
+            }
+            quad = 0;
+            have = 0;
+        }
+    }
+
+    return have == 0;
+}
+
+bool decompress(Compression compression, const uint8_t* in, size_t in_size, uint8_t* out, size_t out_size)
+{
+    switch (compression) {
+    case Compression::None:
+        if (in_size != out_size) {
+            logger->error("Expected {} bytes, got {}", out_size, in_size);
+            return false;
+        }
+        std::memcpy(out, in, out_size);
+        return true;
+    case Compression::Zlib:
+        return inflate_bytes(in, in_size, out, out_size, MAX_WBITS);
+    case Compression::Gzip:
+        return inflate_bytes(in, in_size, out, out_size, MAX_WBITS + 16);
+    case Compression::Zstd:
+#if defined(RAPTR_WITH_ZSTD)
+    {
+        const auto written = ZSTD_decompress(out, out_size, in, in_size);
+        if (ZSTD_isError(written) || written != out_size) {
+            logger->error("zstd gave {} of {} bytes", ZSTD_isError(written) ? 0 : written, out_size);
+            return false;
+        }
+        return true;
+    }
+#else
+        logger->error("zstd compressed data needs the engine built with RAPTR_WITH_ZSTD");
+        return false;
+#endif
+    }
+    return false;
+}
+
+} // namespace raptr
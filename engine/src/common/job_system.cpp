@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <chrono>
+
+#include <raptr/common/job_system.hpp>
+#include <raptr/common/logging.hpp>
+
+namespace {
+auto logger = raptr::_get_logger(__FILE__);
+
+//! The system whose worker this thread is, and the queue it owns there
+thread_local const raptr::JobSystem* home_system = nullptr;
+thread_local size_t home_queue = SIZE_MAX;
+};
+
+namespace raptr {
+
+JobSystem::JobSystem(size_t num_workers)
+{
+    if (num_workers == 0) {
+        const auto hardware = std::thread::hardware_concurrency();
+        num_workers = hardware > 1 ? hardware - 1 : 0;
+    }
+
+    // One queue per worker, plus one shared by threads outside the pool
+    for (size_t i = 0; i <= num_workers; ++i) {
+        queues.push_back(std::make_unique<WorkerQueue>());
+    }
+
+    for (size_t i = 0; i < num_workers; ++i) {
+        workers.emplace_back(&JobSystem::worker_loop, this, i);
+    }
+
+    logger->info("Job system started with {} workers", num_workers);
+}
+
+JobSystem::~JobSystem()
+{
+    shutdown = true;
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+JobHandle JobSystem::schedule(std::function<void()> work, const std::vector<JobHandle>& dependencies)
+{
+    auto job = std::make_shared<Job>();
+    job->work = std::move(work);
+
+    // Hold an extra count so the job can't be enqueued while deps are being registered
+    job->unfinished_dependencies = 1;
+    for (auto& dependency : dependencies) {
+        if (!dependency) {
+            continue;
+        }
+        std::scoped_lock<std::mutex> lck(dependency->continuations_mutex);
+        if (!dependency->done) {
+            ++job->unfinished_dependencies;
+            dependency->continuations.push_back(job);
+        }
+    }
+
+    if (--job->unfinished_dependencies == 0) {
+        this->enqueue(job);
+    }
+
+    return job;
+}
+
+void JobSystem::wait(const JobHandle& job)
+{
+    this->help_until_done(job);
+    if (job->error) {
+        std::rethrow_exception(job->error);
+    }
+}
+
+void JobSystem::help_until_done(const JobHandle& job)
+{
+    const auto queue = this->home();
+    while (!job->done) {
+        if (!this->run_one(queue)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+size_t JobSystem::home() const
+{
+    // Workers of another system share this one's outside queue like any other thread
+    return home_system == this ? home_queue : queues.size() - 1;
+}
+
+void JobSystem::parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn)
+{
+    if (count == 0) {
+        return;
+    }
+
+    grain = std::max<size_t>(grain, 1);
+    if (count <= grain || workers.empty()) {
+        fn(0, count);
+        return;
+    }
+
+    std::vector<JobHandle> chunks;
+    chunks.reserve((count + grain - 1) / grain);
+    for (size_t begin = 0; begin < count; begin += grain) {
+        const auto end = std::min(begin + grain, count);
+        chunks.push_back(this->schedule([&fn, begin, end]() { fn(begin, end); }));
+    }
+
+    // Every chunk refers to fn, so all of them finish before anything is rethrown
+    for (auto& chunk : chunks) {
+        this->help_until_done(chunk);
+    }
+    for (auto& chunk : chunks) {
+        if (chunk->error) {
+            std::rethrow_exception(chunk->error);
+        }
+    }
+}
+
+void JobSystem::worker_loop(size_t index)
+{
+    home_system = this;
+    home_queue = index;
+    while (!shutdown) {
+        if (this->run_one(index)) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lck(sleep_mutex);
+        wake.wait_for(lck, std::chrono::milliseconds(1), [this]() {
+            return shutdown || queued > 0;
+        });
+    }
+}
+
+void JobSystem::enqueue(const JobHandle& job)
+{
+    const auto index = home_system == this
+        ? home_queue
+        : next_queue++ % queues.size();
+
+    {
+        auto& queue = *queues[index];
+        std::scoped_lock<std::mutex> lck(queue.mutex);
+        queue.jobs.push_back(job);
+    }
+
+    ++queued;
+    wake.notify_one();
+}
+
+void JobSystem::finish(const JobHandle& job)
+{
+    std::vector<JobHandle> continuations;
+    {
+        std::scoped_lock<std::mutex> lck(job->continuations_mutex);
+        job->done = true;
+        continuations.swap(job->continuations);
+    }
+
+    for (auto& continuation : continuations) {
+        if (--continuation->unfinished_dependencies == 0) {
+            this->enqueue(continuation);
+        }
+    }
+}
+
+bool JobSystem::run_one(size_t home)
+{
+    auto job = this->pop_or_steal(home);
+    if (!job) {
+        return false;
+    }
+
+    --queued;
+
+    // An exception must not escape a worker thread, so it is kept for wait()
+    try {
+        job->work();
+    } catch (...) {
+        job->error = std::current_exception();
+    }
+    this->finish(job);
+    return true;
+}
+
+JobHandle JobSystem::pop_or_steal(size_t home)
+{
+    // Newest work from our own queue first, it is most likely to be warm in cache
+    {
+        auto& queue = *queues[home];
+        std::scoped_lock<std::mutex> lck(queue.mutex);
+        if (!queue.jobs.empty()) {
+            auto job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+            return job;
+        }
+    }
+
+    // Then the oldest work from everyone else
+    for (size_t i = 1; i < queues.size(); ++i) {
+        auto& queue = *queues[(home + i) % queues.size()];
+        std::scoped_lock<std::mutex> lck(queue.mutex);
+        if (!queue.jobs.empty()) {
+            auto job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+            return job;
+        }
+    }
+
+    return nullptr;
+}
+
+} // namespace raptr
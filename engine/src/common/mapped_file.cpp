@@ -0,0 +1,105 @@
+#include <raptr/common/logging.hpp>
+#include <raptr/common/mapped_file.hpp>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+auto logger = raptr::_get_logger(__FILE__);
+};
+
+namespace raptr {
+
+#if defined(_WIN32)
+std::unique_ptr<MappedFile> MappedFile::open(const fs::path& path)
+{
+    std::unique_ptr<MappedFile> mapped(new MappedFile());
+    mapped->file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (mapped->file == INVALID_HANDLE_VALUE) {
+        mapped->file = nullptr;
+        logger->error("{} could not be opened for mapping", path);
+        return nullptr;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(mapped->file, &file_size) || file_size.QuadPart == 0) {
+        logger->error("{} is empty or its size could not be read", path);
+        return nullptr;
+    }
+
+    mapped->mapping = CreateFileMappingW(mapped->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapped->mapping) {
+        logger->error("{} could not be mapped: {}", path, GetLastError());
+        return nullptr;
+    }
+
+    mapped->bytes = static_cast<const uint8_t*>(MapViewOfFile(mapped->mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!mapped->bytes) {
+        logger->error("{} could not be mapped: {}", path, GetLastError());
+        return nullptr;
+    }
+
+    mapped->length = static_cast<size_t>(file_size.QuadPart);
+    return mapped;
+}
+
+MappedFile::~MappedFile()
+{
+    if (bytes) {
+        UnmapViewOfFile(bytes);
+    }
+    if (mapping) {
+        CloseHandle(mapping);
+    }
+    if (file) {
+        CloseHandle(file);
+    }
+}
+#else
+std::unique_ptr<MappedFile> MappedFile::open(const fs::path& path)
+{
+    std::unique_ptr<MappedFile> mapped(new MappedFile());
+    mapped->fd = ::open(path.c_str(), O_RDONLY);
+    if (mapped->fd < 0) {
+        logger->error("{} could not be opened for mapping", path);
+        return nullptr;
+    }
+
+    struct stat info;
+    if (fstat(mapped->fd, &info) != 0 || info.st_size == 0) {
+        logger->error("{} is empty or its size could not be read", path);
+        return nullptr;
+    }
+
+    void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, mapped->fd, 0);
+    if (view == MAP_FAILED) {
+        logger->error("{} could not be mapped", path);
+        return nullptr;
+    }
+
+    mapped->bytes = static_cast<const uint8_t*>(view);
+    mapped->length = static_cast<size_t>(info.st_size);
+    return mapped;
+}
+
+MappedFile::~MappedFile()
+{
+    if (bytes) {
+        munmap(const_cast<uint8_t*>(bytes), length);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+#endif
+
+} // namespace raptr
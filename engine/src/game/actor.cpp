@@ -10,6 +10,7 @@
 #include <raptr/common/logging.hpp>
 #include <raptr/game/actor.hpp>
 #include <raptr/game/game.hpp>
+#include <raptr/renderer/renderer.hpp>
 #include <raptr/renderer/sprite.hpp>
 
 namespace {
@@ -20,6 +21,7 @@ namespace raptr {
 Actor::Actor()
     : Entity()
 {
+    kind = EntityKind::Actor;
 }
 
 std::shared_ptr<Actor> Actor::from_toml(const FileInfo& toml_path)
@@ -126,6 +128,12 @@ std::shared_ptr<Actor> Actor::from_toml(const FileInfo& toml_path)
     acc.x = 0;
     acc.y = 0;
 
+    actor->load_activity(v);
+    actor->load_collision_filter(v);
+
+    const auto static_value = v.find("actor.static");
+    actor->is_static = static_value && static_value->as<bool>();
+
     return actor;
 }
 
@@ -156,12 +164,20 @@ void Actor::think(std::shared_ptr<Game>& game)
 
 void Actor::render(Renderer* renderer)
 {
+    if (this->skip_dormant_render()) {
+        return;
+    }
+
+    const auto pos = this->render_position(renderer->sim_alpha);
+    sprite->x = pos.x;
+    sprite->y = pos.y;
     sprite->render(renderer);
 }
 
 void Actor::serialize(std::vector<NetField>& list)
 {
     NetFieldType cls = NetFieldType::Actor;
+    this->sync_detached();
 
 // Stop looking at me like that.
 // This macro helps expand our fields into
@@ -2,7 +2,6 @@
 #include <map>
 #include <memory>
 #include <string>
-#include <thread>
 
 #pragma warning(disable : 4996)
 #include <toml/toml.h>
@@ -28,6 +27,7 @@ namespace raptr {
 Character::Character()
     : Entity()
 {
+    kind = EntityKind::Character;
     activate_tile = false;
     is_crouched = false;
     think_frame = 0;
@@ -38,6 +38,9 @@ Character::Character()
     fast_fall = false;
     is_falling = false;
     is_tweening = false;
+    tween_scale = 0;
+    tween_snap = false;
+    pending = {};
 }
 
 void Character::attach_controller(std::shared_ptr<Controller>& controller_)
@@ -280,6 +283,9 @@ std::shared_ptr<Character> Character::from_toml(const FileInfo& toml_path)
     acc.y = 0;
     character->vel_exp.x = 0;
 
+    character->load_activity(v);
+    character->load_collision_filter(v);
+
     return character;
 }
 
@@ -321,67 +327,34 @@ void Character::run_to_rel(double x, double y)
 void Character::move_to(double x, double y, float scale)
 {
     is_tweening = true;
-
-    auto walk_async = [&, x, y, scale]() {
-        auto think_last_frame = think_frame;
-        while (true) {
-            if (think_last_frame == think_frame) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(1));
-                continue;
-            }
-            think_last_frame = think_frame;
-            const auto pos_abs = this->position_abs();
-            const auto made_it = std::fabs(pos_abs.x - x) < 4; // within 4 pixels
-            if (made_it) {
-                this->stop();
-                break;
-            } else if (x > pos_abs.x) {
-                this->walk(scale);
-            } else {
-                this->walk(-scale);
-            }
-        }
-        is_tweening = false;
-    };
-
-    std::thread t1(walk_async);
-    t1.detach();
+    tween_dst = { x, y };
+    tween_scale = scale;
+    tween_snap = false;
 }
 
 void Character::move_to_rel(double x, double y, float scale)
 {
     is_tweening = true;
+    tween_dst = this->position_abs() + Point { x, y };
+    tween_scale = scale;
+    tween_snap = true;
+}
 
-    auto walk_async = [&, x, y, scale]() {
-        auto dst = this->position_abs();
-        dst.x += x;
-        dst.y += y;
-
-        auto think_last_frame = think_frame;
-        while (true) {
-            if (think_last_frame == think_frame) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(1));
-                continue;
-            }
-            think_last_frame = think_frame;
-            const auto pos_abs = this->position_abs();
-            const auto made_it = std::fabs(pos_abs.x - dst.x) < 4; // within 4 pixels
-            if (made_it) {
-                this->position_rel().x += (pos_abs.x - dst.x);
-                this->stop();
-                break;
-            } else if (dst.x > pos_abs.x) {
-                this->walk(scale);
-            } else {
-                this->walk(-scale);
-            }
+void Character::think_tween()
+{
+    const auto pos_abs = this->position_abs();
+    const auto made_it = std::fabs(pos_abs.x - tween_dst.x) < 4; // within 4 pixels
+    if (made_it) {
+        if (tween_snap) {
+            this->position_rel().x += (pos_abs.x - tween_dst.x);
         }
-
+        this->stop();
         is_tweening = false;
-    };
-
-    std::thread t1(walk_async);
-    t1.detach();
+    } else if (tween_dst.x > pos_abs.x) {
+        this->walk(tween_scale);
+    } else {
+        this->walk(-tween_scale);
+    }
 }
 
 void Character::jump()
@@ -483,6 +456,13 @@ bool Character::on_left_joy(const ControllerState& state)
 
 void Character::render(Renderer* renderer)
 {
+    if (this->skip_dormant_render()) {
+        return;
+    }
+
+    const auto pos = this->render_position(renderer->sim_alpha);
+    sprite->x = pos.x;
+    sprite->y = pos.y;
     sprite->render(renderer);
 
     if (flashlight) {
@@ -523,6 +503,7 @@ void Character::run(float scale)
 void Character::serialize(std::vector<NetField>& list)
 {
     NetFieldType cls = NetFieldType::Character;
+    this->sync_detached();
 
 // Stop looking at me like that.
 #define CNF(field) NetFieldMacro(Character, field)
@@ -569,11 +550,18 @@ void Character::stop()
 
 void Character::think(std::shared_ptr<Game>& game)
 {
-    const auto delta_us = game->frame_delta_us;
-    const auto delta_s = delta_us / 1e6;
-    auto& vel = this->velocity_rel();
-    auto& acc = this->acceleration_rel();
-    auto& pos = this->position_rel();
+    this->prepare(game);
+    this->plan(*game);
+    this->commit(game);
+}
+
+void Character::prepare(std::shared_ptr<Game>& game)
+{
+    const auto delta_us = think_delta_us;
+
+    if (is_tweening) {
+        this->think_tween();
+    }
 
     if (is_dead) {
         vel_exp.x = 0;
@@ -584,17 +572,46 @@ void Character::think(std::shared_ptr<Game>& game)
         jump_time_current_us += delta_us;
     }
 
-    bool in_dash = false;
     if (dash_time_usec > 0) {
-        in_dash = true;
         dash_time_usec += delta_us;
     }
 
     if (dash_time_usec > dash_length_usec) {
-        in_dash = false;
         dash_time_usec = 0;
         this->on_left_joy(this->last_controller_state);
     }
+}
+
+bool Character::plan(Game& game)
+{
+    const auto delta_us = think_delta_us;
+    const auto dt = delta_us / 1e6;
+
+    // Everything is computed on copies. Other characters are planning at the
+    // same time and read our position, so it only changes on commit.
+    pending.animation = nullptr;
+    pending.flip_x_changed = false;
+    handoffs.clear();
+
+    Point pos = this->position_rel();
+    Point vel = this->velocity_rel();
+    Point acc = this->acceleration_rel();
+
+    const auto want_position_x = [&]() {
+        auto bbox = this->bbox();
+        bbox.x = pos.x + vel.x * dt;
+        bbox.y = pos.y;
+        return bbox;
+    };
+
+    const auto want_position_y = [&]() {
+        auto bbox = this->bbox();
+        bbox.x = pos.x;
+        bbox.y = pos.y + vel.y * dt + dt * acc.y / 2.0 * dt;
+        return bbox;
+    };
+
+    const bool in_dash = dash_time_usec > 0;
 
     acc.y = gravity_ps2;
     if (in_dash) {
@@ -602,16 +619,16 @@ void Character::think(std::shared_ptr<Game>& game)
     }
 
     // External forces, like gravity
-    Rect fall_check = this->want_position_y(delta_us);
+    Rect fall_check = want_position_y();
     if (gravity_ps2 <= 0) {
         fall_check.y -= 0.05;
-        this->sprite->flip_y = false;
+        pending.flip_y = false;
     } else {
         fall_check.y += 0.05;
-        this->sprite->flip_y = true;
+        pending.flip_y = true;
     }
 
-    auto intersected = game->intersect_anything(this, fall_check);
+    auto intersected = game.intersect_anything(this, fall_check);
     if (!intersected && !in_dash) {
         if (fast_fall) {
             vel.y += fast_fall_scale * gravity_ps2 * delta_us / 1e6;
@@ -627,17 +644,6 @@ void Character::think(std::shared_ptr<Game>& game)
             fast_fall = false;
             //logger->debug("Fell for {}s. Final velocity was {}m/s", fall_time_us / 1e6, vel.y * pixels_to_meters);
             vel.y = 0;
-
-            const double mag_x = std::fabs(vel.x);
-            if (in_dash) {
-                this->set_animation("Dash");
-            } else if (mag_x > walk_speed_ps) {
-                this->set_animation("Run");
-            } else if (mag_x > 0) {
-                this->set_animation("Walk");
-            } else {
-                this->set_animation("Idle");
-            }
         }
         is_falling = false;
         fall_time_us = 0;
@@ -677,70 +683,52 @@ void Character::think(std::shared_ptr<Game>& game)
 
     const auto mag_x = std::fabs(vel.x);
 
-    Rect want_x = this->want_position_x(delta_us);
-    Rect want_y = this->want_position_y(delta_us);
-
-    const auto steps_x = static_cast<int32_t>(std::abs(pos.x - want_x.x) / 4 + 1);
-    const auto delta_x = (pos.x - want_x.x) / double(steps_x);
-    intersected = false;
-    want_x.x = pos.x;
-    for (auto i = 1; i <= steps_x; ++i) {
-        want_x.x -= delta_x * i;
-        intersected |= game->intersect_anything(this, want_x);
-        if (intersected) {
-            break;
-        }
-    }
+    Rect want_x = want_position_x();
+    Rect want_y = want_position_y();
+
+    // Each axis is swept once; the move stops at the first contact instead of being stepped
+    Rect from = this->bbox();
+    from.x = pos.x;
+    from.y = pos.y;
+    const auto hit_x = game.sweep(this, from, { want_x.x - pos.x, 0 });
 
     bool hitting_wall = false;
 
-    if (!intersected) {
+    if (!hit_x.hit) {
         if (vel.x < 0) {
-            sprite->flip_x = false;
+            pending.flip_x_changed = true;
+            pending.flip_x = false;
         } else if (vel.x > 0) {
-            sprite->flip_x = true;
+            pending.flip_x_changed = true;
+            pending.flip_x = true;
         }
 
         // Is there something above us?
-        Rect above_check = this->want_position_y(delta_us);
+        Rect above_check = want_position_y();
         above_check.y += 1;
-        auto intersected = game->intersect_entity(this, above_check);
-        auto character = dynamic_cast<Character*>(intersected.get());
+        const auto character = Game::as_character(game.first_intersecting(this, above_check));
         if (character && !character->moving) {
-            auto& ov = intersected->velocity_rel();
-            ov.x = vel.x;
+            handoffs.push_back({ character->handle, true, vel.x });
         }
         pos.x = want_x.x;
     } else {
+        pos.x += (want_x.x - pos.x) * hit_x.toi;
         hitting_wall = true;
         dash_time_usec = 0;
         vel.x = 0;
         vel_exp.y = 0;
-        if (!is_falling) {
-            this->set_animation("Idle");
-        }
     }
 
-    const auto steps_y = static_cast<int32_t>(std::abs(pos.y - want_y.y) / 4 + 1);
-    const auto delta_y = (pos.y - want_y.y) / double(steps_y);
-    want_y.y = pos.y;
-    intersected = false;
-    for (int32_t i = 1; i <= steps_y; ++i) {
-        want_y.y -= delta_y * i;
-        intersected = game->intersect_anything(this, want_y);
-        if (intersected) {
-            break;
-        }
-    }
+    from.x = pos.x;
+    const auto hit_y = game.sweep(this, from, { 0, want_y.y - pos.y });
 
-    if (!intersected) {
+    if (!hit_y.hit) {
         pos.y = want_y.y;
     } else {
-        auto intersected_entity = game->intersect_entity(this, want_y);
-        const auto character = dynamic_cast<Character*>(intersected_entity.get());
+        pos.y += (want_y.y - pos.y) * hit_y.toi;
+        const auto character = Game::as_character(hit_y.entity);
         if (character) {
-            auto& ov = intersected_entity->velocity_rel();
-            ov.y = vel.y;
+            handoffs.push_back({ character->handle, false, vel.y });
         } else {
             vel.y = 0;
         }
@@ -751,19 +739,42 @@ void Character::think(std::shared_ptr<Game>& game)
     }
 
     if (in_dash) {
-        this->set_animation("Dash");
+        pending.animation = "Dash";
     } else if (is_crouched) {
-        this->set_animation("Crouch");
+        pending.animation = "Crouch";
     } else if (hitting_wall) {
-        this->set_animation("Idle");
+        pending.animation = "Idle";
     } else if (is_falling) {
-        this->set_animation("Jump");
+        pending.animation = "Jump";
     } else if (mag_x > walk_speed_ps) {
-        this->set_animation("Run");
+        pending.animation = "Run";
     } else if (mag_x > 0) {
-        this->set_animation("Walk");
+        pending.animation = "Walk";
     } else {
-        this->set_animation("Idle");
+        pending.animation = "Idle";
+    }
+
+    pending.pos = pos;
+    pending.vel = vel;
+    pending.acc = acc;
+    return true;
+}
+
+void Character::commit(std::shared_ptr<Game>& game)
+{
+    const auto delta_us = think_delta_us;
+
+    this->position_rel() = pending.pos;
+    this->velocity_rel() = pending.vel;
+    this->acceleration_rel() = pending.acc;
+
+    sprite->flip_y = pending.flip_y;
+    if (pending.flip_x_changed) {
+        sprite->flip_x = pending.flip_x;
+    }
+
+    if (pending.animation) {
+        this->set_animation(pending.animation);
     }
 
     auto sprite_pos = this->position_abs();
@@ -8,6 +8,7 @@ auto logger = raptr::_get_logger(__FILE__);
 namespace raptr {
 
 Console::Console()
+    : commands(64)
 {
     shutdown = false;
     lua.open_libraries(sol::lib::base, sol::lib::coroutine, sol::lib::string, sol::lib::io);
@@ -22,31 +23,28 @@ Console::~Console()
 
 void Console::push(const std::string& command)
 {
-    std::scoped_lock<std::mutex> lck(mutex);
-    commands.push_back(command);
+    if (!commands.try_push(command)) {
+        logger->warn("Console is busy, dropping command: {}", command);
+    }
 }
 
 void Console::process_commands()
 {
-    std::scoped_lock<std::mutex> lck(mutex);
-    for (const auto& command : commands) {
+    bool ran_command = false;
+    std::string command;
+    while (commands.try_pop(command)) {
+        ran_command = true;
         try {
-            if (command == "!") {
-                lua.safe_script(last_command);
-            } else {
-                lua.safe_script(command);
-            }
+            lua.safe_script(command);
         } catch (const std::exception& e) {
             logger->error(e.what());
         }
     }
 
-    if (!commands.empty()) {
+    if (ran_command) {
         std::cout << std::endl
                   << "> ";
     }
-
-    commands.clear();
 }
 
 void Console::think()
@@ -74,7 +72,9 @@ void Console::think()
 
         if (!in_block) {
             auto cmd = buffer.str();
-            if (cmd != "!") {
+            if (cmd == "!") {
+                cmd = last_command;
+            } else {
                 last_command = cmd;
             }
             this->push(cmd);
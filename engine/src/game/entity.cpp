@@ -1,6 +1,12 @@
+#include <cmath>
+
 #include <SDL.h>
 #include <crossguid/guid.hpp>
-#include <raptr/common/clock.hpp>
+
+#pragma warning(disable : 4996)
+#include <toml/toml.h>
+#pragma warning(default : 4996)
+
 #include <raptr/common/logging.hpp>
 #include <raptr/game/character.hpp>
 #include <raptr/game/entity.hpp>
@@ -16,11 +22,29 @@ Entity::Entity()
     auto g = xg::newGuid();
     is_dead = false;
     guid_ = g.bytes();
+    handle = {};
+    entities_index = 0;
+    pending_removal = false;
+    activity = Activity::Active;
+    last_think_tick = 0;
+    awake_until_tick = 0;
+    think_delta_us = 0;
+    render_skipped = false;
+    store = nullptr;
+    store_index = 0;
+    pos_ = { 0, 0 };
+    vel_ = { 0, 0 };
+    acc_ = { 0, 0 };
     fall_time_us = 0;
     collidable = true;
+    kind = EntityKind::Other;
+    collision_category = 1;
+    collision_mask = ~0u;
+    is_static = false;
     think_rate_us = 0;
     gravity_ps2 = 0;
-    last_think_time_us = clock::ticks();
+    think_scheduled = false;
+    think_due = false;
 }
 
 const std::array<unsigned char, 16>& Entity::guid() const
@@ -66,21 +90,117 @@ Rect Entity::want_position_y(int64_t delta_us)
     return bbox;
 }
 
+Point Entity::render_position(double alpha) const
+{
+    const auto current = this->position_abs();
+    if (!store) {
+        return current;
+    }
+
+    const auto& prev = store->prev_position[store_index];
+    const auto delta = current - prev;
+
+    // Anything that moved further than this in a tick was teleported, so
+    // there is nothing meaningful to interpolate across.
+    if (std::fabs(delta.x) > 64.0 || std::fabs(delta.y) > 64.0) {
+        return current;
+    }
+
+    return { prev.x + delta.x * alpha, prev.y + delta.y * alpha };
+}
+
+void Entity::sync_detached()
+{
+    if (!store) {
+        return;
+    }
+
+    pos_ = store->position[store_index];
+    vel_ = store->velocity[store_index];
+    acc_ = store->acceleration[store_index];
+}
+
+void Entity::load_activity(const toml::Value& root)
+{
+    const auto number = [&](const std::string& key, double default_value) {
+        const auto found = root.find(key);
+        return found ? found->asNumber() : default_value;
+    };
+
+    auto& config = activity_config;
+    config.reduced_radius_px = number("activity.reduced_radius_px", config.reduced_radius_px);
+    config.sleep_radius_px = number("activity.sleep_radius_px", config.sleep_radius_px);
+    config.reduced_think_us = static_cast<int64_t>(
+        number("activity.reduced_think_ms", config.reduced_think_us / 1e3) * 1e3);
+    config.wake_us = static_cast<int64_t>(number("activity.wake_ms", config.wake_us / 1e3) * 1e3);
+
+    if (config.sleep_radius_px > 0 && config.sleep_radius_px < config.reduced_radius_px) {
+        logger->warn("activity.sleep_radius_px is inside activity.reduced_radius_px, the reduced rate is never used");
+    }
+}
+
+void Entity::load_collision_filter(const toml::Value& root)
+{
+    const auto bits = [&](const std::string& key, uint32_t default_value) {
+        const auto found = root.find(key);
+        return found ? static_cast<uint32_t>(found->as<int64_t>()) : default_value;
+    };
+
+    collision_category = bits("collision.category", collision_category);
+    collision_mask = bits("collision.mask", collision_mask);
+
+    if (collision_category == 0) {
+        logger->warn("{} has collision.category = 0, nothing will collide with it", name);
+    }
+}
+
+bool Entity::skip_dormant_render()
+{
+    // Reduced entities are only thinking less often, and may still be on camera
+    if (activity == Activity::Asleep) {
+        render_skipped = true;
+        return true;
+    }
+
+    if (render_skipped) {
+        render_skipped = false;
+        sprite->catch_up();
+    }
+    return false;
+}
+
 bool Entity::is_player() const
 {
-    return dynamic_cast<const Character*>(this) != nullptr;
+    return kind == EntityKind::Character;
+}
+
+bool Entity::collides_with(const Entity* other) const
+{
+    return (collision_mask & other->collision_category) != 0
+        && (other->collision_mask & collision_category) != 0;
+}
+
+BroadphaseTag Entity::broadphase_tag() const
+{
+    BroadphaseTag tag;
+    tag.category = collision_category;
+    tag.mask = collision_mask;
+    tag.kind = static_cast<uint8_t>(kind);
+    return tag;
 }
 
 void Entity::add_velocity(double x_kmh, double y_kmh)
 {
-    vel_.x += x_kmh * kmh_to_ps;
-    vel_.y += y_kmh * kmh_to_ps;
+    auto& vel = this->velocity_rel();
+    vel.x += x_kmh * kmh_to_ps;
+    vel.y += y_kmh * kmh_to_ps;
 }
 
 void Entity::add_acceleration(double x_ms2, double y_ms2)
 {
-    acc_.x += x_ms2 * meters_to_pixels;
-    acc_.y += y_ms2 * meters_to_pixels;
+    auto& acc = this->acceleration_rel();
+    acc.x += x_ms2 * meters_to_pixels;
+    acc.y += y_ms2 * meters_to_pixels;
 }
 
 AnimationFrame* Entity::collision_frame() const
@@ -90,11 +210,11 @@ AnimationFrame* Entity::collision_frame() const
 
 bool Entity::intersects(const Entity* other) const
 {
-    if (other->guid() == this->guid()) {
+    if (other == this) {
         return false;
     }
 
-    if (!other->collidable || !this->collidable) {
+    if (!other->collidable || !this->collidable || !this->collides_with(other)) {
         return false;
     }
 
@@ -125,11 +245,11 @@ bool Entity::intersects(const Rect& bbox) const
 
 bool Entity::intersects(const Entity* other, const Rect& bbox) const
 {
-    if (other->guid() == this->guid()) {
+    if (other == this) {
         return false;
     }
 
-    if (!other->collidable || !this->collidable) {
+    if (!other->collidable || !this->collidable || !this->collides_with(other)) {
         return false;
     }
 
@@ -146,66 +266,19 @@ bool Entity::intersect_slow(const Entity* other, const Rect& this_bbox) const
         return false;
     }
 
-    auto& this_sprite = this->sprite;
-    const auto& this_surface = this_sprite->surface;
-    const uint8_t* this_pixels = reinterpret_cast<uint8_t*>(this_surface->pixels);
-    const int32_t this_bpp = this_surface->format->BytesPerPixel;
-
-    auto& other_sprite = other->sprite;
-    const auto& other_surface = other_sprite->surface;
-    const uint8_t* other_pixels = reinterpret_cast<uint8_t*>(other_surface->pixels);
-    const int32_t other_bpp = other_surface->format->BytesPerPixel;
-
-    auto this_pos = this->position_abs();
-    const auto other_pos = other->position_abs();
-    auto this_frame = this->collision_frame();
-    auto other_frame = other->collision_frame();
-
-    // Box 1
-    double ax0 = this_bbox.x;
-    double ax1 = ax0 + this_bbox.w - 1;
-    double ay0 = this_bbox.y;
-    double ay1 = ay0 + this_bbox.h - 1;
-
-    // Box 2
-    double bx0 = other_pos.x;
-    double bx1 = other_pos.x + other_frame->w - 1;
-    double by0 = other_pos.y;
-    double by1 = other_pos.y + other_frame->h - 1;
-
-    // Overlap
-    auto cx0 = std::max(ax0, bx0);
-    auto cx1 = std::min(ax1, bx1);
-    auto cy0 = std::max(ay0, by0);
-    auto cy1 = std::min(ay1, by1);
-
-    // This pixel offsets
-    auto tx0 = static_cast<int32_t>(cx0 - ax0);
-    auto ty0 = static_cast<int32_t>(cy0 - ay0);
-
-    // Other pixel offsets
-    auto ox0 = static_cast<int32_t>(cx0 - bx0);
-    auto oy0 = static_cast<int32_t>(cy0 - by0);
-
-    auto th = static_cast<int32_t>(this_bbox.h - 1);
-    auto oh = static_cast<int32_t>(other_frame->h - 1);
-
-    auto w = static_cast<int32_t>(cx1 - cx0);
-    auto h = static_cast<int32_t>(cy1 - cy0);
-
-    for (int32_t x = 0; x < w; ++x) {
-        for (int32_t y = 0; y < h; ++y) {
-            int32_t this_idx = (this_frame->y + th - (ty0 + y)) * this_surface->pitch + (tx0 + x + this_frame->x) * this_bpp;
-            int32_t other_idx = (other_frame->y + oh - (oy0 + y)) * other_surface->pitch + (ox0 + x + other_frame->x) * other_bpp;
-            const uint8_t* this_px = this_pixels + this_idx;
-            const uint8_t* other_px = other_pixels + other_idx;
-            if (*this_px > 0 && *other_px > 0) {
-                return true;
-            }
-        }
+    const auto this_frame = this->collision_frame();
+    const auto other_frame = other->collision_frame();
+    if (!this_frame->masks || !other_frame->masks) {
+        return false;
     }
 
-    return false;
+    // Entity pairs are tested as the frames were drawn, without either sprite's flips
+    const auto& this_mask = this_frame->masks->get(false, false);
+    const auto& other_mask = other_frame->masks->get(false, false);
+    const auto other_pos = other->position_abs();
+    return this_mask.overlaps(other_mask,
+        static_cast<int32_t>(other_pos.x - this_bbox.x),
+        static_cast<int32_t>(other_pos.y - this_bbox.y));
 }
 
 bool Entity::intersect_slow(const Rect& other_box) const
@@ -214,36 +287,18 @@ bool Entity::intersect_slow(const Rect& other_box) const
         return false;
     }
 
-    const auto& surface = sprite->surface;
-    const uint8_t* pixels = reinterpret_cast<uint8_t*>(surface->pixels);
-    const int32_t bpp = surface->format->BytesPerPixel;
-
-    const auto pos = this->position_abs();
-    auto frame = this->collision_frame();
-
-    // x0 position
-    const auto x0_min = static_cast<int32_t>(std::max(other_box.x, pos.x));
-    const auto x0_max = static_cast<int32_t>(std::min(other_box.x + other_box.w,
-        pos.x + frame->w - 1));
-
-    // y0 position
-    const auto y0_min = static_cast<int32_t>(std::max(other_box.y, pos.y));
-    const auto y0_max = static_cast<int32_t>(std::min(other_box.y + other_box.h,
-        pos.y + frame->h - 1));
-
-    int32_t th = surface->h;
-
-    for (int32_t x0 = x0_min; x0 <= x0_max; ++x0) {
-        for (int32_t y0 = y0_min; y0 <= y0_max; ++y0) {
-            const int32_t idx = (frame->y + th - y0) * surface->pitch + (x0 + frame->x) * bpp;
-            const uint8_t* px = pixels + idx;
-            if (*px > 0) {
-                return true;
-            }
-        }
+    const auto frame = this->collision_frame();
+    if (!frame->masks) {
+        return false;
     }
 
-    return false;
+    // The box in the frame's own pixels, covering every pixel it touches
+    const auto pos = this->position_abs();
+    return frame->masks->get(false, false).any(
+        static_cast<int32_t>(std::floor(other_box.x - pos.x)),
+        static_cast<int32_t>(std::floor(other_box.y - pos.y)),
+        static_cast<int32_t>(std::ceil(other_box.x + other_box.w - pos.x)),
+        static_cast<int32_t>(std::ceil(other_box.y + other_box.h - pos.y)));
 }
 
 void Entity::add_child(std::shared_ptr<Entity> child)
@@ -303,10 +358,19 @@ void Entity::setup_lua_context(sol::state& state)
         "Entity",
         "e", [](Entity* e) { return e->shared_from_this(); },
         "guid", &Entity::guid_str,
-        "pos", &Entity::pos_,
-        "vel", &Entity::vel_,
-        "acc", &Entity::acc_,
+        "handle", sol::readonly_property([](Entity& e) { return e.handle.value; }),
+        // Copies, since a spawn or removal can move the store rows a reference would point into
+        "pos", sol::property([](Entity& e) -> Point { return e.position_rel(); }, [](Entity& e, const Point& p) { e.position_rel() = p; }),
+        "vel", sol::property([](Entity& e) -> Point { return e.velocity_rel(); }, [](Entity& e, const Point& p) { e.velocity_rel() = p; }),
+        "acc", sol::property([](Entity& e) -> Point { return e.acceleration_rel(); }, [](Entity& e, const Point& p) { e.acceleration_rel() = p; }),
+        "set_pos", [](Entity& e, double x, double y) { e.position_rel() = { x, y }; },
+        "set_vel", [](Entity& e, double x, double y) { e.velocity_rel() = { x, y }; },
+        "set_acc", [](Entity& e, double x, double y) { e.acceleration_rel() = { x, y }; },
         "gravity_ps2", &Entity::gravity_ps2,
+        "is_static", sol::readonly(&Entity::is_static),
+        "kind", sol::readonly_property([](Entity& e) { return static_cast<uint32_t>(e.kind); }),
+        "collision_category", sol::readonly(&Entity::collision_category),
+        "collision_mask", sol::readonly(&Entity::collision_mask),
         "add_child", &Entity::add_child,
         "remove_child", &Entity::remove_child,
         "set_parent", &Entity::set_parent,
@@ -0,0 +1,97 @@
+#include <raptr/common/logging.hpp>
+#include <raptr/game/entity.hpp>
+#include <raptr/game/entity_store.hpp>
+
+namespace {
+auto logger = raptr::_get_logger(__FILE__);
+};
+
+namespace raptr {
+
+uint32_t EntityStore::attach(Entity* entity)
+{
+    if (entity->store) {
+        logger->error("{} is already attached to an entity store", entity->name);
+        return entity->store_index;
+    }
+
+    const auto index = static_cast<uint32_t>(owner.size());
+    const auto pos_abs = entity->position_abs();
+    const auto bounds = entity->bounds();
+
+    position.push_back(entity->pos_);
+    velocity.push_back(entity->vel_);
+    acceleration.push_back(entity->acc_);
+    prev_position.push_back(pos_abs);
+    last_position.push_back(pos_abs);
+    last_bounds.push_back(bounds);
+    fat_bounds.push_back(bounds);
+    flags.push_back(0);
+    owner.push_back(entity);
+    handle.push_back(entity->handle);
+
+    entity->store = this;
+    entity->store_index = index;
+    this->refresh_flags(index);
+    return index;
+}
+
+void EntityStore::detach(Entity* entity)
+{
+    if (entity->store != this) {
+        return;
+    }
+
+    const auto index = entity->store_index;
+    const auto last = static_cast<uint32_t>(owner.size() - 1);
+
+    // Keep the entity usable once it has left the store
+    entity->pos_ = position[index];
+    entity->vel_ = velocity[index];
+    entity->acc_ = acceleration[index];
+    entity->store = nullptr;
+    entity->store_index = 0;
+
+    if (index != last) {
+        position[index] = position[last];
+        velocity[index] = velocity[last];
+        acceleration[index] = acceleration[last];
+        prev_position[index] = prev_position[last];
+        last_position[index] = last_position[last];
+        last_bounds[index] = last_bounds[last];
+        fat_bounds[index] = fat_bounds[last];
+        flags[index] = flags[last];
+        owner[index] = owner[last];
+        handle[index] = handle[last];
+        owner[index]->store_index = index;
+    }
+
+    position.pop_back();
+    velocity.pop_back();
+    acceleration.pop_back();
+    prev_position.pop_back();
+    last_position.pop_back();
+    last_bounds.pop_back();
+    fat_bounds.pop_back();
+    flags.pop_back();
+    owner.pop_back();
+    handle.pop_back();
+}
+
+void EntityStore::refresh_flags(uint32_t index)
+{
+    const auto entity = owner[index];
+    uint8_t f = 0;
+    if (entity->collidable) {
+        f |= EntityFlagCollidable;
+    }
+    if (entity->do_pixel_collision_test) {
+        f |= EntityFlagPixelTest;
+    }
+    if (entity->is_dead) {
+        f |= EntityFlagDead;
+    }
+    flags[index] = f;
+}
+
+} // namespace raptr
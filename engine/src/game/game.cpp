@@ -1,8 +1,11 @@
 #include <SDL_joystick.h>
 
 #include <algorithm>
+#include <array>
 #include <chrono>
+#include <cmath>
 #include <functional>
+#include <limits>
 #include <memory>
 #include <thread>
 #include <vector>
@@ -11,6 +14,7 @@
 
 #include <raptr/common/filesystem.hpp>
 #include <raptr/common/logging.hpp>
+#include <raptr/common/sweep.hpp>
 #include <raptr/config.hpp>
 #include <raptr/game/actor.hpp>
 #include <raptr/game/character.hpp>
@@ -38,6 +42,11 @@ namespace raptr {
 
 Game::~Game()
 {
+    // The render loop refers back to this game, so it has to finish first
+    shutdown = true;
+    if (renderer_thread.joinable()) {
+        renderer_thread.join();
+    }
     //SDL_Quit();
 }
 
@@ -107,53 +116,37 @@ bool Game::deserialize(const std::vector<NetField>& fields)
   This allows a server and client to communicate events before handling them
   directly.  This function will dispath and call the appropriately handlers.
 */
-void Game::dispatch_event(const std::shared_ptr<EngineEvent>& event)
+void Game::dispatch_event(EngineEvent& event)
 {
-    switch (event->type) {
-    // The user has decided to load a new map
-    case EngineEventType::LoadMap: {
-        const auto map_event = reinterpret_cast<LoadMapEvent*>(event->data);
-        this->handle_load_map_event(*map_event);
-        delete map_event;
-        break;
-    }
+    struct Dispatcher {
+        Game& game;
 
-    // There is a controller event that has occured in the system
-    case EngineEventType::ControllerEvent: {
-        const auto controller_event = reinterpret_cast<ControllerEvent*>(event->data);
-        this->handle_controller_event(*controller_event);
-        delete controller_event;
-        break;
-    }
+        // The user has decided to load a new map
+        void operator()(LoadMapEvent& e) { game.handle_load_map_event(e); }
 
-    // A new character is being spawned into the game
-    case EngineEventType::SpawnCharacter: {
-        const auto character_event = reinterpret_cast<CharacterSpawnEvent*>(event->data);
-        this->handle_character_spawn_event(*character_event);
-        delete character_event;
-        break;
-    }
+        // There is a controller event that has occured in the system
+        void operator()(ControllerEvent& e) { game.handle_controller_event(e); }
 
-    // A new actor is being spawned into the game
-    case EngineEventType::SpawnActor: {
-        const auto staticmesh_event = reinterpret_cast<ActorSpawnEvent*>(event->data);
-        this->handle_actor_spawn_event(*staticmesh_event);
-        delete staticmesh_event;
-        break;
-    }
+        // A new character is being spawned into the game
+        void operator()(CharacterSpawnEvent& e) { game.handle_character_spawn_event(e); }
 
-    // A trigger is being spawned into the game
-    case EngineEventType::SpawnTrigger: {
-        const auto trigger_event = reinterpret_cast<TriggerSpawnEvent*>(event->data);
-        this->handle_trigger_spawn_event(*trigger_event);
-        delete trigger_event;
-        break;
-    }
+        // A new actor is being spawned into the game
+        void operator()(ActorSpawnEvent& e) { game.handle_actor_spawn_event(e); }
 
-    default: {
-        logger->info("Unhandled event type: {}", static_cast<int32_t>(event->type));
-    }
-    }
+        // A trigger is being spawned into the game
+        void operator()(TriggerSpawnEvent& e) { game.handle_trigger_spawn_event(e); }
+    };
+
+    std::visit(Dispatcher { *this }, event.data);
+
+    // The slot is recycled rather than destroyed, so drop anything the
+    // callback captured now instead of whenever the slot is reused.
+    std::visit([](auto& e) {
+        if constexpr (!std::is_same_v<std::decay_t<decltype(e)>, ControllerEvent>) {
+            e.callback = nullptr;
+        }
+    },
+        event.data);
 }
 
 /*
@@ -179,8 +172,7 @@ void Game::handle_actor_spawn_event(const ActorSpawnEvent& event)
 {
     auto actor = Actor::from_toml(game_path.from_root(event.path));
     actor->guid_ = event.guid;
-    actor->pos_.x = 0;
-    actor->pos_.y = 0;
+    actor->position_rel() = { 0, 0 };
 
     // A scripted actor will get the full aresenal of objects to
     // interact with, that is why we pass the lua context from the actor
@@ -192,7 +184,9 @@ void Game::handle_actor_spawn_event(const ActorSpawnEvent& event)
         actor->lua.safe_script(actor->lua_script);
     }
 
-    this->spawn_now(actor);
+    if (!this->spawn_now(actor)) {
+        return;
+    }
     event.callback(actor);
 
     // Once the actor is entirely initialized in the engine, then the
@@ -208,11 +202,9 @@ void Game::handle_character_spawn_event(const CharacterSpawnEvent& event)
     character->guid_ = event.guid;
 
     if (map) {
-        character->pos_.x = map->player_spawn.x;
-        character->pos_.y = map->player_spawn.y;
+        character->position_rel() = { map->player_spawn.x, map->player_spawn.y };
     } else {
-        character->pos_.x = 0;
-        character->pos_.y = 0;
+        character->position_rel() = { 0, 0 };
     }
 
     if (character->is_scripted) {
@@ -222,7 +214,9 @@ void Game::handle_character_spawn_event(const CharacterSpawnEvent& event)
         character->lua.safe_script(character->lua_script);
     }
 
-    this->spawn_now(character);
+    if (!this->spawn_now(character)) {
+        return;
+    }
     event.callback(character);
     if (character->is_scripted) {
         character->lua["init"]();
@@ -230,16 +224,13 @@ void Game::handle_character_spawn_event(const CharacterSpawnEvent& event)
 
     characters.push_back(character);
 
-    std::vector<std::shared_ptr<Entity>> to_erase;
-    for (auto& entity : renderer->camera.tracking) {
-        if (entity->is_dead) {
-            to_erase.push_back(entity);
-        }
-    }
-
-    for (auto& e : to_erase) {
-        erase(renderer->camera.tracking, e);
-    }
+    std::scoped_lock<std::mutex> lck(renderer->mutex);
+    auto& tracking = renderer->camera.tracking;
+    tracking.erase(std::remove_if(tracking.begin(), tracking.end(), [&](const EntityHandle& handle) {
+        const auto entity = this->resolve(handle);
+        return !entity || entity->is_dead;
+    }),
+        tracking.end());
 }
 
 void Game::handle_controller_event(const ControllerEvent& controller_event)
@@ -280,7 +271,7 @@ void Game::handle_load_map_event(const LoadMapEvent& event)
         erase(renderer->observing, map);
     }
 
-    map = Map::load(game_path.from_root(fs::path("maps") / event.name));
+    map = Map::load(game_path.from_root(fs::path("maps") / event.name), config);
     if (!map) {
         logger->error("{} is not a valid map", event.name);
         return;
@@ -288,6 +279,10 @@ void Game::handle_load_map_event(const LoadMapEvent& event)
 
     map->name = event.name;
     renderer->add_observable(map);
+
+    // Repack whatever static entities outlived the old map; anything spawned
+    // for the new one is packed in a single batch once this frame's events are done
+    this->pack_static_broadphase(true);
     renderer->camera_basic.min_x = 0;
     renderer->camera_basic.min_y = 0;
     renderer->camera_basic.max_x = map->width * map->tile_width;
@@ -301,7 +296,9 @@ void Game::handle_trigger_spawn_event(const TriggerSpawnEvent& event)
 {
     auto trigger = Trigger::from_params(event.rect);
     trigger->guid_ = event.guid;
-    this->spawn_now(trigger);
+    if (!this->spawn_now(trigger)) {
+        return;
+    }
     event.callback(trigger);
 }
 
@@ -315,7 +312,7 @@ void Game::hide_collision_frames()
 
 bool Game::intersect_world(Entity* entity, const Rect& bbox)
 {
-    return map->intersects(entity, bbox) != nullptr;
+    return static_cast<bool>(map->intersects(entity, bbox));
 }
 
 bool Game::intersect_anything(Entity* entity, const Rect& bbox)
@@ -323,104 +320,301 @@ bool Game::intersect_anything(Entity* entity, const Rect& bbox)
     if (this->intersect_world(entity, bbox)) {
         return true;
     }
-    const auto found = this->intersect_entity(entity, bbox);
-    return !!found;
+    return this->first_intersecting(entity, bbox) != nullptr;
 }
 
-std::vector<std::shared_ptr<Entity>> Game::intersect_entities(
-    Entity* entity, const Rect& bbox, IntersectEntityFilter post_filter, size_t limit)
+SweepHit Game::sweep(Entity* entity, const Rect& from, const Point& delta) const
 {
-    double min_bounds[2] = { bbox.x, bbox.y };
-    double max_bounds[2] = { bbox.x + bbox.w, bbox.y + bbox.h };
-
-    struct ConditionMet {
-        Entity* check;
-        Rect bbox;
-        size_t limit;
-        std::vector<Entity*> found;
-        bool intersected;
-        IntersectEntityFilter post_filter;
-    } condition_met;
-
-    condition_met.check = entity;
-    condition_met.intersected = false;
-    condition_met.bbox = bbox;
-    condition_met.post_filter = post_filter;
-    condition_met.limit = limit;
-
-    rtree.Search(
-        min_bounds, max_bounds, [](Entity* found, void* context) -> bool {
-            const auto condition = reinterpret_cast<ConditionMet*>(context);
-            Entity* self = condition->check;
-            if (self->guid() == found->guid()) {
-                return true;
+    SweepHit result;
+    if ((delta.x == 0 && delta.y == 0) || !entity->collidable) {
+        return result;
+    }
+
+    // The earliest box contacts in order of time; anything later is dropped
+    struct Candidate {
+        SweepContact contact;
+        Entity* entity;
+        TileRef tile;
+        Rect box;
+    };
+    std::array<Candidate, 32> candidates;
+    size_t count = 0;
+
+    // The earliest contact that did not fit, if any
+    auto overflow_toi = 2.0;
+
+    const auto consider = [&](const Rect& box, Entity* found, const TileRef& tile) {
+        SweepContact contact;
+        if (!sweep_rect(from, delta, box, contact)) {
+            return;
+        }
+
+        if (count == candidates.size()) {
+            if (contact.toi >= candidates[count - 1].contact.toi) {
+                overflow_toi = std::min(overflow_toi, contact.toi);
+                return;
             }
+            overflow_toi = std::min(overflow_toi, candidates[count - 1].contact.toi);
+            --count;
+        }
 
-            if (!found->collidable) {
+        auto i = count++;
+        for (; i > 0 && candidates[i - 1].contact.toi > contact.toi; --i) {
+            candidates[i] = candidates[i - 1];
+        }
+        candidates[i] = { contact, found, tile, box };
+    };
+
+    const auto area = swept_rect(from, delta);
+    if (map) {
+        map->for_each_tile(area, TileFlag::Collidable, [&](const TileRef& tile, const Rect& box) {
+            consider(box, nullptr, tile);
+            return true;
+        });
+    }
+
+    struct Context {
+        const Game* game;
+        const Entity* self;
+        decltype(consider)* consider;
+    } context { this, entity, &consider };
+
+    const auto filter = this->collision_filter(entity);
+    this->query_entities(
+        Bounds(area.x, area.x + area.w, area.y, area.y + area.h), &filter, [](EntityHandle handle, void* opaque) -> bool {
+            const auto context = reinterpret_cast<Context*>(opaque);
+            if (context->self->handle == handle) {
                 return true;
             }
 
-            bool has_intersection = false;
-            if (self->do_pixel_collision_test && found->do_pixel_collision_test) {
-                has_intersection = self->intersects(found, condition->bbox);
-            } else {
-                has_intersection = self->intersects(condition->bbox);
+            const auto found_ptr = context->game->entity_slots.get(handle);
+            if (!found_ptr || !(*found_ptr)->collidable) {
+                return true;
             }
 
-            if (has_intersection && condition->post_filter(found)) {
-                condition->intersected = true;
-                condition->found.push_back(found);
+            Entity* found = found_ptr->get();
+            (*context->consider)(found->bbox(), found, TileRef());
+            return true;
+        },
+        &context);
+
+    // Pixel shapes sit inside their boxes, so a box contact only says where to start looking.
+    // March a pixel at a time from it, and stop at the best contact found so far.
+    const auto length = std::sqrt(delta.x * delta.x + delta.y * delta.y);
+    const auto step = 1.0 / std::max(length, 1.0);
+    const auto touches = [&](const Candidate& candidate, const Rect& at) {
+        if (candidate.tile) {
+            return map->intersect_precise(candidate.tile, static_cast<int32_t>(candidate.box.x),
+                static_cast<int32_t>(candidate.box.y), entity, at, true);
+        }
+        return entity->intersects(candidate.entity, at);
+    };
+
+    for (size_t i = 0; i < count; ++i) {
+        const auto& candidate = candidates[i];
+        if (result.hit && candidate.contact.toi >= result.toi) {
+            break;
+        }
 
-                if (condition->limit > 0 && condition->found.size() >= condition->limit) {
-                    return false;
+        auto toi = candidate.contact.toi;
+        const bool pixel_test = entity->do_pixel_collision_test
+            && (candidate.tile || candidate.entity->do_pixel_collision_test);
+
+        if (pixel_test) {
+            const auto limit = result.hit ? result.toi : 1.0;
+            bool touched = false;
+            for (auto t = candidate.contact.toi;; t += step) {
+                t = std::min(t, limit);
+                Rect at = from;
+                at.x += delta.x * t;
+                at.y += delta.y * t;
+                if (touches(candidate, at)) {
+                    toi = std::max(candidate.contact.toi, t - step);
+                    touched = true;
+                    break;
+                }
+                if (t >= limit) {
+                    break;
                 }
             }
 
-            return true;
-        },
-        reinterpret_cast<void*>(&condition_met));
+            if (!touched) {
+                continue;
+            }
+        }
 
-    if (condition_met.intersected) {
-        std::vector<std::shared_ptr<Entity>> entities_found;
+        result.hit = true;
+        result.toi = toi;
+        result.normal = candidate.contact.normal;
+        result.entity = candidate.entity;
+        result.tile = candidate.tile.tile;
+    }
 
-        for (auto& found : condition_met.found) {
-            entities_found.push_back(entity_lut[found->guid()]);
+    // Too crowded to hold every contact; carry on from the first one that was dropped
+    if (overflow_toi <= 1 && (!result.hit || result.toi > overflow_toi)) {
+        if (overflow_toi <= 0) {
+            logger->debug("{} overlaps more than {} boxes, treating its move as blocked", entity->name, candidates.size());
+            result.hit = true;
+            result.toi = 0;
+            return result;
         }
 
-        return entities_found;
+        Rect at = from;
+        at.x += delta.x * overflow_toi;
+        at.y += delta.y * overflow_toi;
+        auto rest = this->sweep(entity, at, { delta.x * (1 - overflow_toi), delta.y * (1 - overflow_toi) });
+        if (rest.hit && (!result.hit || overflow_toi + rest.toi * (1 - overflow_toi) < result.toi)) {
+            rest.toi = overflow_toi + rest.toi * (1 - overflow_toi);
+            return rest;
+        }
     }
 
-    return {};
+    return result;
 }
 
-std::shared_ptr<Entity> Game::intersect_entity(
-    Entity* entity, const Rect& bbox, IntersectEntityFilter post_filter)
+Entity* Game::first_intersecting(Entity* entity, const Rect& bbox) const
 {
-    auto found = this->intersect_entities(entity, bbox, post_filter, 1);
-    if (found.empty()) {
+    Entity* first = nullptr;
+    this->for_each_intersecting(entity, bbox, [&](Entity* found) {
+        first = found;
+        return false;
+    });
+    return first;
+}
+
+Entity* Game::narrow_phase(const Entity* self, EntityHandle candidate, const Rect& bbox) const
+{
+    if (self && self->handle == candidate) {
         return nullptr;
     }
 
-    return found[0];
+    const auto found_ptr = entity_slots.get(candidate);
+    if (!found_ptr) {
+        return nullptr;
+    }
+
+    Entity* found = found_ptr->get();
+    if (!found->collidable) {
+        return nullptr;
+    }
+
+    bool has_intersection = false;
+    if (self && self->do_pixel_collision_test && found->do_pixel_collision_test) {
+        has_intersection = self->intersects(found, bbox);
+    } else if (self) {
+        has_intersection = self->intersects(bbox);
+    } else {
+        has_intersection = found->intersects(bbox);
+    }
+
+    return has_intersection ? found : nullptr;
 }
 
-std::vector<std::shared_ptr<Character>> Game::intersect_characters(
-    Entity* entity, const Rect& bbox, IntersectCharacterFilter post_filter, size_t limit)
+Character* Game::as_character(Entity* entity)
 {
-    IntersectEntityFilter combined_filter = [&](const Entity* entity) -> bool {
-        auto character = dynamic_cast<const Character*>(entity);
-        if (!character) {
-            return false;
+    if (!entity || entity->kind != EntityKind::Character) {
+        return nullptr;
+    }
+    return static_cast<Character*>(entity);
+}
+
+BroadphaseFilter Game::collision_filter(const Entity* entity, uint32_t kinds) const
+{
+    BroadphaseFilter filter;
+    if (entity) {
+        filter.category = entity->collision_category;
+        filter.mask = entity->collision_mask;
+    }
+    filter.kinds = kinds;
+    return filter;
+}
+
+std::vector<std::shared_ptr<Entity>> Game::intersect_entities(
+    Entity* entity, const Rect& bbox, IntersectEntityFilter post_filter, size_t limit)
+{
+    std::vector<std::shared_ptr<Entity>> found;
+    this->for_each_intersecting(entity, bbox, [&](Entity* hit) {
+        if (!post_filter(hit)) {
+            return true;
         }
+        found.push_back(hit->shared_from_this());
+        return limit == 0 || found.size() < limit;
+    });
+
+    return found;
+}
+
+size_t Game::query_entities(const Bounds& bounds, BroadphaseCallback callback, void* context) const
+{
+    return this->query_entities(bounds, nullptr, callback, context);
+}
 
-        return post_filter(character);
+size_t Game::query_entities(const Bounds& bounds, const BroadphaseFilter* filter, BroadphaseCallback callback, void* context) const
+{
+    struct Merge {
+        BroadphaseCallback callback;
+        void* context;
+        bool stopped;
+    } merge { callback, context, false };
+
+    const auto forward = [](EntityHandle handle, void* merge_context) -> bool {
+        const auto merge = reinterpret_cast<Merge*>(merge_context);
+        if (!merge->callback(handle, merge->context)) {
+            merge->stopped = true;
+            return false;
+        }
+        return true;
     };
 
-    std::vector<std::shared_ptr<Character>> characters;
-    for (auto& found : this->intersect_entities(entity, bbox, combined_filter, limit)) {
-        characters.push_back(std::dynamic_pointer_cast<Character>(found));
+    size_t found = 0;
+    for (const auto handle : static_spawns) {
+        const auto entity = entity_slots.get(handle);
+        if (!entity || (filter && !filter_accepts(*filter, (*entity)->broadphase_tag()))) {
+            continue;
+        }
+        if (bounds_overlap((*entity)->bounds(), bounds)) {
+            ++found;
+            if (!forward(handle, &merge)) {
+                return found;
+            }
+        }
+    }
+
+    found += static_broadphase->query(bounds, filter, forward, &merge);
+    if (merge.stopped) {
+        return found;
     }
 
+    return found + broadphase->query(bounds, filter, forward, &merge);
+}
+
+std::shared_ptr<Entity> Game::intersect_entity(
+    Entity* entity, const Rect& bbox, IntersectEntityFilter post_filter)
+{
+    std::shared_ptr<Entity> first;
+    this->for_each_intersecting(entity, bbox, [&](Entity* hit) {
+        if (!post_filter(hit)) {
+            return true;
+        }
+        first = hit->shared_from_this();
+        return false;
+    });
+    return first;
+}
+
+std::vector<std::shared_ptr<Character>> Game::intersect_characters(
+    Entity* entity, const Rect& bbox, IntersectCharacterFilter post_filter, size_t limit)
+{
+    std::vector<std::shared_ptr<Character>> characters;
+    this->for_each_intersecting(entity, bbox, [&](Entity* hit) {
+        const auto character = as_character(hit);
+        if (!character || !post_filter(character)) {
+            return true;
+        }
+        characters.push_back(std::static_pointer_cast<Character>(character->shared_from_this()));
+        return limit == 0 || characters.size() < limit;
+    });
+
     return characters;
 }
 
@@ -454,6 +648,29 @@ bool Game::init()
     config = std::make_shared<Config>();
     gravity_ps2 = -18.0 * meters_to_pixels;
 
+    sim_accumulator_us = 0;
+    sim_tick = 0;
+    sim_dormant = 0;
+    sim_in_tick = false;
+    dispatching_events = false;
+    sim_alpha = 0;
+    sim_max_catchup_ticks = config->max_catchup_ticks;
+    game_thread = std::this_thread::get_id();
+    posted_events = std::make_unique<MpscQueue<EngineEvent>>(config->event_queue_capacity);
+    posted_events_drops_seen = 0;
+    jobs = std::make_unique<JobSystem>(config->job_threads);
+    this->set_tick_rate(config->tick_rate_hz);
+
+    broadphase = Broadphase::create(config->broadphase, config->broadphase_cell_size);
+    static_broadphase = Broadphase::create("rtree");
+    broadphase_update_count = 0;
+    broadphase_reinsert_count = 0;
+    if (!broadphase) {
+        logger->error("Failed to create the {} broadphase", config->broadphase);
+        shutdown = true;
+        return false;
+    }
+
     if (!this->init_controllers()) {
         logger->error("Failed to initialize controllers");
         shutdown = true;
@@ -565,7 +782,7 @@ bool Game::init_demo()
 
   this->spawn_character("actors/mad-block/mad-block.toml", [&](auto& mesh)
   {
-    (*this)["mad-block"] = mesh;
+    this->set_entity_name("mad-block", mesh);
     mesh->position_rel().y = 200;
     mesh->position_rel().x = 20;
   });
@@ -624,6 +841,7 @@ bool Game::init_renderer()
     renderer->camera_basic.top = -270;
     renderer->camera_basic.bottom = 270;
     renderer->last_render_time_us = 0;
+    renderer->camera.entities = &entity_slots;
     renderer->game_root = game_path;
 
     if (use_threaded_renderer) {
@@ -652,9 +870,12 @@ bool Game::init_sound()
 
 bool Game::interact_with_world(Entity* entity)
 {
-    auto tile = map->intersects(entity, "Interactive");
+    auto tile = map->intersects(entity, TileFlag::Interactive);
     if (tile) {
-        map->activate_tile(this->shared_from_this(), entity, tile);
+        // Only objects carry a dialog or script to run
+        if (tile.placed) {
+            map->activate_tile(this->shared_from_this(), entity, tile.placed);
+        }
         return true;
     }
     return false;
@@ -682,23 +903,74 @@ void Game::kill_entity(const std::shared_ptr<Entity>& entity)
         return this->kill_character(std::dynamic_pointer_cast<Character>(entity));
     }
     entity->is_dead = true;
+
+    // Wake it so the reaper sees it on the next tick
+    this->wake(entity);
 }
 
 void Game::kill_by_guid(const std::array<unsigned char, 16>& guid)
 {
-    auto found = entity_lut.find(guid);
-    if (found == entity_lut.end()) {
+    const auto entity = this->resolve(this->handle_from_guid(guid));
+    if (!entity) {
+        return;
+    }
+    this->kill_entity(entity);
+}
+
+EntityHandle Game::handle_from_guid(const GUID& guid) const
+{
+    const auto found = guid_to_handle.find(guid);
+    if (found == guid_to_handle.end()) {
+        return {};
+    }
+    return found->second;
+}
+
+std::shared_ptr<Entity> Game::operator[](const std::string& key) const
+{
+    if (key.size() == 16) {
+        GUID guid;
+        std::copy(key.begin(), key.end(), guid.begin());
+        const auto found = guid_to_handle.find(guid);
+        if (found != guid_to_handle.end()) {
+            return this->resolve(found->second);
+        }
+    }
+
+    const auto found = entity_short_lut.find(key);
+    if (found == entity_short_lut.end()) {
+        return nullptr;
+    }
+    return this->resolve(found->second);
+}
+
+void Game::set_entity_name(const std::string& name, const std::shared_ptr<Entity>& entity)
+{
+    const auto previous = entity_short_lut.find(name);
+    if (previous != entity_short_lut.end()) {
+        const auto names = entity_short_names.find(previous->second);
+        if (names != entity_short_names.end()) {
+            erase(names->second, name);
+            if (names->second.empty()) {
+                entity_short_names.erase(names);
+            }
+        }
+    }
+
+    if (!entity) {
+        entity_short_lut.erase(name);
         return;
     }
-    this->kill_entity(found->second);
+    entity_short_lut[name] = entity->handle;
+    entity_short_names[entity->handle].push_back(name);
 }
 
 void Game::load_map(const std::string& map_name, LoadMapEvent::Callback callback)
 {
-    auto event = new LoadMapEvent();
-    event->name = map_name;
-    event->callback = callback;
-    this->add_event<LoadMapEvent>(event);
+    LoadMapEvent event;
+    event.name = map_name;
+    event.callback = callback;
+    this->post_event(std::move(event));
 }
 
 bool Game::poll_events()
@@ -715,19 +987,19 @@ bool Game::poll_events()
 
     if (is_controller || is_joystick) {
         const int32_t controller_id = e.jdevice.which;
-        auto controller_event = new ControllerEvent();
-        controller_event->controller_id = controller_id;
-        controller_event->sdl_event = e;
-        this->add_event(controller_event);
+        ControllerEvent controller_event;
+        controller_event.controller_id = controller_id;
+        controller_event.sdl_event = e;
+        this->post_event(std::move(controller_event));
     } else if (e.type == SDL_KEYDOWN && e.key.keysym.scancode == SDL_SCANCODE_F1) {
         renderer->toggle_fullscreen();
     } else if (e.type == SDL_KEYDOWN && e.key.keysym.scancode == SDL_SCANCODE_F2) {
         auto controller = controllers.begin();
         ++controller;
-        auto x = characters[0]->pos_.x;
+        auto x = characters[0]->position_rel().x;
         this->spawn_character("characters/raptr.toml", [&](auto& character) {
             character->attach_controller(controller->second);
-            character->pos_.x = x;
+            character->position_rel().x = x;
             renderer->camera_follow(character);
         });
     } else if (e.type == SDL_KEYDOWN && e.key.keysym.scancode == SDL_SCANCODE_F3) {
@@ -751,10 +1023,10 @@ bool Game::poll_events()
             this->show_collision_frames();
         }
     } else if (e.type == SDL_KEYDOWN || e.type == SDL_KEYUP) {
-        auto controller_event = new ControllerEvent();
-        controller_event->controller_id = -1;
-        controller_event->sdl_event = e;
-        this->add_event(controller_event);
+        ControllerEvent controller_event;
+        controller_event.controller_id = -1;
+        controller_event.sdl_event = e;
+        this->post_event(std::move(controller_event));
     } else if (e.type == SDL_WINDOWEVENT) {
         if (e.window.event == SDL_WINDOWEVENT_CLOSE) {
             this->shutdown = true;
@@ -766,35 +1038,274 @@ bool Game::poll_events()
 bool Game::process_engine_events()
 {
     const auto current_time_us = clock::ticks();
+    sim_accumulator_us += current_time_us - frame_last_time;
+    frame_last_time = current_time_us;
+
+    this->dispatch_engine_events();
+
+    // Consume the elapsed time in fixed steps. If we fall too far behind, then
+    // the backlog is dropped rather than letting the simulation spiral.
+    int32_t ticks_run = 0;
+    while (sim_accumulator_us >= sim_dt_us) {
+        if (ticks_run >= sim_max_catchup_ticks) {
+            logger->debug("Dropping {}us of simulation backlog", sim_accumulator_us);
+            sim_accumulator_us %= sim_dt_us;
+            break;
+        }
+        this->simulate_tick();
+        sim_accumulator_us -= sim_dt_us;
+        ++ticks_run;
+    }
 
-    frame_delta_us = current_time_us - frame_last_time;
+    sim_alpha = sim_accumulator_us / static_cast<double>(sim_dt_us);
+    renderer->sim_alpha = sim_alpha;
 
-    frame_last_time = clock::ticks();
+    if (!use_threaded_renderer) {
+        renderer->run_frame();
+    }
+
+    return true;
+}
+
+void Game::dispatch_engine_events()
+{
+    if (dispatching_events) {
+        logger->error("Can not dispatch engine events while they are already being dispatched");
+        return;
+    }
+    dispatching_events = true;
 
     auto& current_events = this->engine_events_buffers[this->engine_event_index];
     this->engine_event_index = (this->engine_event_index + 1) % 2;
-    for (auto& engine_event : current_events) {
-        this->dispatch_event(engine_event);
+
+    // Pull everything other threads have posted into this frame's ring
+    while (true) {
+        auto& slot = current_events.push_back();
+        if (!posted_events->try_pop(slot)) {
+            current_events.pop_back();
+            break;
+        }
+    }
+
+    const auto drops = posted_events->drops();
+    if (drops != posted_events_drops_seen) {
+        logger->warn("Dropped {} engine events, the queue holds {}",
+            drops - posted_events_drops_seen, posted_events->capacity());
+        posted_events_drops_seen = drops;
+    }
+    while (!current_events.empty()) {
+        this->dispatch_event(current_events.front());
+        current_events.pop_front();
+    }
+
+    // Static entities spawned by this frame's events go into the static broadphase together
+    this->pack_static_broadphase();
+    dispatching_events = false;
+}
+
+std::vector<Bounds> Game::focus_bounds()
+{
+    std::vector<Bounds> centers;
+    for (auto& character : characters) {
+        if (character->controller && character->store) {
+            centers.push_back(entity_store.last_bounds[character->store_index]);
+        }
     }
 
+    if (!is_headless) {
+        std::scoped_lock<std::mutex> lck(renderer->mutex);
+        centers.push_back(renderer->camera.bounds.current);
+    }
+    return centers;
+}
+
+void Game::update_activity()
+{
+    auto& store = entity_store;
+    sim_thinking.assign(store.size(), 1);
+    sim_dormant = 0;
+
+    // Distances are measured from every player and from the camera view
+    const auto centers = this->focus_bounds();
+
+    for (uint32_t i = 0; i < store.size(); ++i) {
+        Entity* entity = store.owner[i];
+        const auto& config = entity->activity_config;
+
+        auto activity = Activity::Active;
+        const bool can_rest = config.reduced_radius_px > 0 || config.sleep_radius_px > 0;
+        if (can_rest && !centers.empty() && sim_tick >= entity->awake_until_tick) {
+            const auto& b = store.last_bounds[i];
+            auto nearest = std::numeric_limits<double>::max();
+            for (const auto& c : centers) {
+                const auto dx = std::max({ 0.0, c.min[0] - b.max[0], b.min[0] - c.max[0] });
+                const auto dy = std::max({ 0.0, c.min[1] - b.max[1], b.min[1] - c.max[1] });
+                nearest = std::min(nearest, std::sqrt(dx * dx + dy * dy));
+            }
+
+            if (config.sleep_radius_px > 0 && nearest > config.sleep_radius_px) {
+                activity = Activity::Asleep;
+            } else if (config.reduced_radius_px > 0 && nearest > config.reduced_radius_px) {
+                activity = Activity::Reduced;
+            }
+        }
+
+        entity->activity = activity;
+        if (activity != Activity::Active) {
+            ++sim_dormant;
+        }
+
+        const auto since = std::max<uint64_t>(sim_tick - entity->last_think_tick, 1);
+        const auto since_us = static_cast<int64_t>(since) * sim_dt_us;
+        bool thinks = activity == Activity::Active
+            || (activity == Activity::Reduced && since_us >= config.reduced_think_us);
+
+        // Scheduled entities only think when the timing wheel says they are due
+        if (entity->think_scheduled) {
+            thinks = thinks && entity->think_due;
+            entity->think_due = false;
+        }
+
+        sim_thinking[i] = thinks;
+        if (thinks) {
+            // Time spent asleep is not simulated; a long nap is one reduced step at most
+            entity->think_delta_us = std::min(since_us, std::max(sim_dt_us, config.reduced_think_us));
+            entity->last_think_tick = sim_tick;
+        }
+    }
+}
+
+void Game::wake(const std::shared_ptr<Entity>& entity)
+{
+    if (!entity) {
+        return;
+    }
+
+    const auto hold_ticks = entity->activity_config.wake_us / std::max<int64_t>(sim_dt_us, 1);
+    entity->awake_until_tick = std::max(entity->awake_until_tick, sim_tick + hold_ticks + 1);
+    entity->activity = Activity::Active;
+}
+
+void Game::simulate_tick()
+{
+    sim_in_tick = true;
+    frame_delta_us = sim_dt_us;
+
     auto this_ptr = this->shared_from_this();
-    for (auto& entity : entities) {
-        entity->think(this_ptr);
+    auto& store = entity_store;
+
+    this->pack_static_broadphase();
+
+    // Fire whatever the timing wheel has due this tick before deciding who thinks
+    timers.advance(sim_tick + 1, [&](GameTimer& timer) -> uint64_t {
+        if (timer.callback) {
+            timer.callback();
+            return timer.interval_ticks ? timers.now() + timer.interval_ticks : 0;
+        }
+
+        const auto entity = this->resolve(timer.entity);
+        if (!entity) {
+            return 0;
+        }
+
+        if (entity->think_rate_us <= 0) {
+            entity->think_scheduled = false;
+            return 0;
+        }
 
-        const Point& old_point = last_known_entity_pos[entity];
+        entity->think_due = true;
+        return timers.now() + this->ticks_for(entity->think_rate_us);
+    });
+
+    this->update_activity();
+
+    // Prepare: timers and input, one entity at a time
+    for (uint32_t i = 0; i < store.size(); ++i) {
+        Entity* entity = store.owner[i];
+        store.prev_position[i] = entity->position_abs();
+        if (sim_thinking[i]) {
+            entity->prepare(this_ptr);
+        }
+    }
+
+    // Plan: every entity works out its move against the world as it was at
+    // the start of the tick. Nothing is written to shared state here.
+    sim_planned.assign(store.size(), 0);
+    jobs->parallel_for(store.size(), config->plan_batch_size, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            sim_planned[i] = sim_thinking[i] && store.owner[i]->plan(*this);
+        }
+    });
+
+    // Commit: apply the plans in entity order so the outcome is deterministic
+    for (uint32_t i = 0; i < store.size(); ++i) {
+        if (!sim_thinking[i]) {
+            continue;
+        }
+
+        Entity* entity = store.owner[i];
+        if (sim_planned[i]) {
+            entity->commit(this_ptr);
+        } else {
+            entity->think(this_ptr);
+        }
+        store.refresh_flags(i);
+
+        auto& old_point = store.last_position[i];
         Point new_point = entity->position_abs();
 
         if (std::fabs(old_point.x - new_point.x) > 0.5 || std::fabs(old_point.y - new_point.y) > 0.5) {
-            auto& lb = last_known_entity_bounds[entity];
-            rtree.Remove(lb.min, lb.max, entity.get());
-            auto nb = entity->bounds();
-            last_known_entity_bounds[entity] = nb;
-            rtree.Insert(nb.min, nb.max, entity.get());
-            last_known_entity_pos[entity] = entity->position_abs();
+            auto& lb = store.last_bounds[i];
+            lb = entity->bounds();
+            old_point = new_point;
+            ++broadphase_update_count;
+
+            // The broadphase only needs to hear about it once the entity leaves its enlarged box
+            auto& fat = store.fat_bounds[i];
+            if (entity->is_static) {
+                // It moved after all, so it belongs with the dynamic entities from now on
+                this->unlink_static(store.handle[i], fat);
+                entity->is_static = false;
+                fat = this->fat_bounds_for(i);
+                broadphase->insert(store.handle[i], fat, entity->broadphase_tag());
+                ++broadphase_reinsert_count;
+                logger->debug("{} is static but moved, it is now tracked as dynamic", entity->name);
+            } else if (!bounds_contain(fat, lb)) {
+                const auto refattened = this->fat_bounds_for(i);
+                broadphase->move(store.handle[i], fat, refattened);
+                fat = refattened;
+                ++broadphase_reinsert_count;
+            }
+
+            // Anything dormant this entity has moved into wakes up
+            if (sim_dormant > 0) {
+                struct WakeContext {
+                    Game* game;
+                    const Bounds* bounds;
+                } wake_context { this, &lb };
+
+                this->query_entities(
+                    lb, [](EntityHandle handle, void* context) -> bool {
+                        const auto wake_context = reinterpret_cast<WakeContext*>(context);
+                        const auto game = wake_context->game;
+                        const auto found = game->entity_slots.get(handle);
+                        if (!found || (*found)->activity == Activity::Active) {
+                            return true;
+                        }
+
+                        // The broadphase holds enlarged boxes, so check the exact ones
+                        const auto& found_bounds = game->entity_store.last_bounds[(*found)->store_index];
+                        if (bounds_overlap(found_bounds, *wake_context->bounds)) {
+                            game->wake(*found);
+                        }
+                        return true;
+                    },
+                    &wake_context);
+            }
         }
 
-        if (!entity->is_dead) {
-            auto tile_intersected = this->map->intersects(entity.get(), "Death");
+        if (!(store.flags[i] & EntityFlagDead)) {
+            auto tile_intersected = this->map->intersects(entity, TileFlag::Death);
             if (tile_intersected) {
                 if (!use_threaded_renderer) {
                     renderer->run_frame();
@@ -804,26 +1315,48 @@ bool Game::process_engine_events()
         std::this_thread::sleep_for(std::chrono::milliseconds(250));
         clock::start();
         */
-                this->kill_entity(entity);
+                this->kill_entity(entity->shared_from_this());
             }
         }
 
+        // Characters play out their death; anything else that died is reaped
+        if (entity->is_dead && !entity->is_player()) {
+            this->remove_entity(entity->shared_from_this());
+        }
+
         if (new_point.y < -100) {
             entity->position_rel().y = 500;
         }
     }
 
+    // Velocity handed between entities (e.g. carrying a character) lands last
+    // so that it is not overwritten by the receiver's own commit
+    for (uint32_t i = 0; i < store.size(); ++i) {
+        auto& handoffs = store.owner[i]->handoffs;
+        for (const auto& handoff : handoffs) {
+            const auto other = this->resolve(handoff.to);
+            if (!other) {
+                continue;
+            }
+            this->wake(other);
+            auto& vel = other->velocity_rel();
+            if (handoff.x_axis) {
+                vel.x = handoff.value;
+            } else {
+                vel.y = handoff.value;
+            }
+        }
+        handoffs.clear();
+    }
+
     if (map) {
         map->think(this_ptr);
     }
 
-    current_events.clear();
-
-    if (!use_threaded_renderer) {
-        renderer->run_frame();
-    }
+    this->flush_removals();
 
-    return true;
+    ++sim_tick;
+    sim_in_tick = false;
 }
 
 bool Game::run()
@@ -848,51 +1381,100 @@ bool Game::remove_entity_by_key(const std::string key)
 
 bool Game::remove_entity(std::shared_ptr<Entity> entity)
 {
+    if (!entity || entity->pending_removal) {
+        return false;
+    }
+
+    entity->pending_removal = true;
+    removal_queue.push_back(std::move(entity));
+    return true;
+}
+
+void Game::flush_removals()
+{
+    if (removal_queue.empty()) {
+        return;
+    }
+
     std::scoped_lock<std::mutex> lck(renderer->mutex);
 
-    for (auto& child : entity->children) {
-        this->remove_entity(child);
+    // Children leave with their parents. The queue grows while it is walked.
+    for (size_t i = 0; i < removal_queue.size(); ++i) {
+        const auto children = removal_queue[i]->children;
+        for (auto& child : children) {
+            this->remove_entity(child);
+        }
     }
 
-    entity->children.clear();
+    bool removed_player = false;
+    for (auto& entity : removal_queue) {
+        entity->children.clear();
 
-    last_known_entity_pos.erase(entity);
+        if (entity->store) {
+            const auto& fat = entity_store.fat_bounds[entity->store_index];
+            if (entity->is_static) {
+                this->unlink_static(entity->handle, fat);
+            } else {
+                broadphase->remove(entity->handle, fat);
+            }
+            entity_store.detach(entity.get());
+        }
 
-    auto b = last_known_entity_bounds[entity];
-    rtree.Remove(b.min, b.max, entity.get());
-    last_known_entity_bounds.erase(entity);
-    erase(entities, entity);
+        // Swap-and-pop; the order of entities carries no meaning
+        const auto index = entity->entities_index;
+        if (index < entities.size() && entities[index] == entity) {
+            if (index != entities.size() - 1) {
+                entities[index] = std::move(entities.back());
+                entities[index]->entities_index = index;
+            }
+            entities.pop_back();
+        }
 
-    std::vector<std::string> keys_to_remove;
-    for (auto& pair : entity_short_lut) {
-        if (pair.second == entity) {
-            keys_to_remove.push_back(pair.first);
+        const auto names = entity_short_names.find(entity->handle);
+        if (names != entity_short_names.end()) {
+            for (auto& name : names->second) {
+                entity_short_lut.erase(name);
+            }
+            entity_short_names.erase(names);
         }
-    }
 
-    for (auto& k : keys_to_remove) {
-        entity_short_lut.erase(k);
+        guid_to_handle.erase(entity->guid());
+
+        if (entity->parent && !entity->parent->pending_removal) {
+            entity->parent->remove_child(entity);
+        }
+
+        removed_player = removed_player || entity->is_player();
+        entity_slots.erase(entity->handle);
+        entity->handle = {};
     }
 
-    entity_lut.erase(entity->guid());
+    // Everything below keeps its order, so it is filtered in one pass each
+    // rather than searched once per removed entity
+    const auto is_removed = [](const auto& object) {
+        const auto entity = dynamic_cast<const Entity*>(object.get());
+        return entity && entity->pending_removal;
+    };
 
-    if (entity->is_player()) {
-        const auto character = std::dynamic_pointer_cast<Character>(entity);
-        erase(characters, character);
+    auto& observing = renderer->observing;
+    observing.erase(std::remove_if(observing.begin(), observing.end(), is_removed), observing.end());
+
+    auto& tracking = renderer->camera.tracking;
+    tracking.erase(std::remove_if(tracking.begin(), tracking.end(), [&](const EntityHandle& handle) {
+        return !entity_slots.contains(handle);
+    }),
+        tracking.end());
+
+    if (removed_player) {
+        characters.erase(std::remove_if(characters.begin(), characters.end(), is_removed), characters.end());
         for (auto& pair : controller_to_character) {
-            erase(pair.second, character);
+            auto& list = pair.second;
+            list.erase(std::remove_if(list.begin(), list.end(), is_removed), list.end());
         }
     }
 
-    if (entity->parent) {
-        entity->parent->remove_child(entity);
-    }
-
-    erase(renderer->camera.tracking, entity);
-    erase(renderer->observing, entity);
-
-    entity.reset();
-    return true;
+    logger->debug("Removed {} entities", removal_queue.size());
+    removal_queue.clear();
 }
 
 void Game::serialize(std::vector<NetField>& list)
@@ -914,6 +1496,224 @@ void Game::set_gravity(double m_s2)
     }
 }
 
+size_t Game::event_queue_depth() const
+{
+    return posted_events->depth();
+}
+
+uint64_t Game::event_queue_drops() const
+{
+    return posted_events->drops();
+}
+
+void Game::set_broadphase_margin(double margin_px, double lookahead_ticks)
+{
+    config->broadphase_margin_px = std::max(margin_px, 0.0);
+    config->broadphase_lookahead_ticks = std::max(lookahead_ticks, 0.0);
+}
+
+uint64_t Game::broadphase_updates() const
+{
+    return broadphase_update_count;
+}
+
+uint64_t Game::broadphase_reinserts() const
+{
+    return broadphase_reinsert_count;
+}
+
+double Game::broadphase_reinsert_rate() const
+{
+    if (broadphase_update_count == 0) {
+        return 0;
+    }
+    return static_cast<double>(broadphase_reinsert_count) / broadphase_update_count;
+}
+
+void Game::pack_static_broadphase(bool rebuild)
+{
+    if (static_spawns.empty() && !rebuild) {
+        return;
+    }
+
+    std::vector<BroadphaseEntry> batch;
+    const auto add = [&](Entity* entity) {
+        // Static boxes are exact and only change if the entity moves, which makes it dynamic
+        const auto index = entity->store_index;
+        entity_store.last_position[index] = entity->position_abs();
+        entity_store.last_bounds[index] = entity->bounds();
+        entity_store.fat_bounds[index] = entity_store.last_bounds[index];
+        batch.push_back({ entity->handle, entity_store.fat_bounds[index], entity->broadphase_tag() });
+    };
+
+    if (rebuild) {
+        static_broadphase->clear();
+        for (uint32_t i = 0; i < entity_store.size(); ++i) {
+            if (entity_store.owner[i]->is_static) {
+                add(entity_store.owner[i]);
+            }
+        }
+    } else {
+        for (const auto handle : static_spawns) {
+            const auto entity = entity_slots.get(handle);
+            if (entity && (*entity)->store && (*entity)->is_static) {
+                add(entity->get());
+            }
+        }
+    }
+
+    static_spawns.clear();
+    static_broadphase->insert_batch(batch);
+}
+
+void Game::unlink_static(EntityHandle handle, const Bounds& bounds)
+{
+    const auto pending = std::find(static_spawns.begin(), static_spawns.end(), handle);
+    if (pending != static_spawns.end()) {
+        static_spawns.erase(pending);
+        return;
+    }
+
+    static_broadphase->remove(handle, bounds);
+}
+
+void Game::set_collision_filter(const std::shared_ptr<Entity>& entity, uint32_t category, uint32_t mask)
+{
+    if (!entity) {
+        return;
+    }
+
+    entity->collision_category = category;
+    entity->collision_mask = mask;
+    if (!entity->store) {
+        return;
+    }
+
+    const auto& fat = entity_store.fat_bounds[entity->store_index];
+    if (!entity->is_static) {
+        broadphase->retag(entity->handle, fat, entity->broadphase_tag());
+    } else if (std::find(static_spawns.begin(), static_spawns.end(), entity->handle) == static_spawns.end()) {
+        // Static entities still waiting to be packed pick up the new tag when they are
+        static_broadphase->retag(entity->handle, fat, entity->broadphase_tag());
+    }
+}
+
+Bounds Game::fat_bounds_for(uint32_t index) const
+{
+    const auto& velocity = entity_store.velocity[index];
+    const auto lookahead_s = config->broadphase_lookahead_ticks * sim_dt_us / 1e6;
+    return fatten_bounds(entity_store.last_bounds[index], config->broadphase_margin_px,
+        velocity.x * lookahead_s, velocity.y * lookahead_s);
+}
+
+void Game::set_tick_rate(int32_t hz)
+{
+    if (hz <= 0) {
+        logger->error("{} is not a valid tick rate", hz);
+        return;
+    }
+
+    config->tick_rate_hz = hz;
+    sim_dt_us = static_cast<int64_t>(1e6 / hz);
+    frame_delta_us = sim_dt_us;
+    logger->info("Simulating at {} ticks per second ({}us per tick)", hz, sim_dt_us);
+}
+
+double Game::fast_forward(uint64_t ticks, int64_t dt_us)
+{
+    if (sim_in_tick || dispatching_events) {
+        logger->error("Can not fast-forward from inside a simulation tick or an event callback");
+        return 0;
+    }
+
+    const auto previous_dt_us = sim_dt_us;
+    if (dt_us > 0) {
+        sim_dt_us = dt_us;
+    }
+
+    const bool was_virtual = clock::is_virtual();
+    clock::set_virtual(true);
+
+    const auto updates_before = broadphase_update_count;
+    const auto reinserts_before = broadphase_reinsert_count;
+
+    // Shutting down stops the run early, so only the ticks that ran are reported
+    uint64_t ran = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (; ran < ticks && !shutdown; ++ran) {
+        clock::advance(sim_dt_us);
+        this->dispatch_engine_events();
+        this->simulate_tick();
+    }
+    const auto wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const auto simulated_s = ran * sim_dt_us / 1e6;
+    clock::set_virtual(was_virtual);
+    sim_dt_us = previous_dt_us;
+    frame_delta_us = sim_dt_us;
+
+    // Whatever wall time passed while fast-forwarding is not owed to the simulation
+    frame_last_time = clock::ticks();
+    sim_accumulator_us = 0;
+
+    const auto ticks_per_second = wall_s > 0 ? ran / wall_s : 0.0;
+    logger->info("Fast-forwarded {} of {} ticks ({:.2f}s simulated) in {:.3f}s, {:.0f} ticks per second ({:.1f}x real time)",
+        ran, ticks, simulated_s, wall_s, ticks_per_second, wall_s > 0 ? simulated_s / wall_s : 0.0);
+
+    const auto updates = broadphase_update_count - updates_before;
+    const auto reinserts = broadphase_reinsert_count - reinserts_before;
+    logger->info("The broadphase reinserted {} of {} moves ({:.1f}%)",
+        reinserts, updates, updates > 0 ? 100.0 * reinserts / updates : 0.0);
+    return ticks_per_second;
+}
+
+bool Game::set_broadphase(const std::string& kind, double cell_size)
+{
+    if (sim_in_tick) {
+        logger->error("Can not change the broadphase from inside a simulation tick");
+        return false;
+    }
+
+    auto replacement = Broadphase::create(kind, cell_size);
+    if (!replacement) {
+        return false;
+    }
+
+    for (size_t i = 0; i < entity_store.size(); ++i) {
+        if (!entity_store.owner[i]->is_static) {
+            replacement->insert(entity_store.handle[i], entity_store.fat_bounds[i], entity_store.owner[i]->broadphase_tag());
+        }
+    }
+
+    broadphase = std::move(replacement);
+    logger->info("Using the {} broadphase for {} entities", broadphase->name(), broadphase->size());
+    return true;
+}
+
+GameTimers::TimerId Game::after(int64_t delay_us, std::function<void()> callback)
+{
+    return timers.schedule(timers.now() + this->ticks_for(delay_us), { {}, std::move(callback), 0 });
+}
+
+GameTimers::TimerId Game::every(int64_t interval_us, std::function<void()> callback)
+{
+    const auto interval_ticks = this->ticks_for(interval_us);
+    return timers.schedule(timers.now() + interval_ticks, { {}, std::move(callback), interval_ticks });
+}
+
+bool Game::cancel_timer(GameTimers::TimerId id)
+{
+    return timers.cancel(id);
+}
+
+uint64_t Game::ticks_for(int64_t us) const
+{
+    if (us <= sim_dt_us) {
+        return 1;
+    }
+    return static_cast<uint64_t>((us + sim_dt_us - 1) / sim_dt_us);
+}
+
 void Game::show_collision_frames()
 {
     for (auto& entity : entities) {
@@ -948,12 +1748,12 @@ Spawn an entity to the world
 */
 void Game::spawn_actor(const std::string& path, ActorSpawnEvent::Callback callback)
 {
-    auto event = new ActorSpawnEvent();
+    ActorSpawnEvent event;
     auto g = xg::newGuid();
-    event->guid = g.bytes();
-    event->path = path;
-    event->callback = callback;
-    this->add_event<ActorSpawnEvent>(event);
+    event.guid = g.bytes();
+    event.path = path;
+    event.callback = callback;
+    this->post_event(std::move(event));
 }
 
 /*!
@@ -961,12 +1761,12 @@ Spawn an entity to the world
 */
 void Game::spawn_character(const std::string& path, CharacterSpawnEvent::Callback callback)
 {
-    auto event = new CharacterSpawnEvent();
+    CharacterSpawnEvent event;
     auto g = xg::newGuid();
-    event->guid = g.bytes();
-    event->path = path;
-    event->callback = callback;
-    this->add_event<CharacterSpawnEvent>(event);
+    event.guid = g.bytes();
+    event.path = path;
+    event.callback = callback;
+    this->post_event(std::move(event));
 }
 
 /*!
@@ -974,24 +1774,31 @@ Spawn a trigger to the world
 */
 void Game::spawn_trigger(const Rect& rect, TriggerSpawnEvent::Callback callback)
 {
-    auto event = new TriggerSpawnEvent();
+    TriggerSpawnEvent event;
     auto g = xg::newGuid();
-    event->guid = g.bytes();
-    event->rect = rect;
-    event->callback = callback;
-    this->add_event<TriggerSpawnEvent>(event);
+    event.guid = g.bytes();
+    event.rect = rect;
+    event.callback = callback;
+    this->post_event(std::move(event));
 }
 
-void Game::spawn_now(const std::shared_ptr<Entity>& entity)
+bool Game::spawn_now(const std::shared_ptr<Entity>& entity)
 {
     std::scoped_lock<std::mutex> lck(renderer->mutex);
-    auto pos = entity->position_abs();
-
-    auto b = entity->bounds();
-    last_known_entity_pos[entity] = entity->position_abs();
-    last_known_entity_bounds[entity] = b;
+    entity->handle = entity_slots.insert(entity);
+    if (!entity->handle) {
+        logger->error("Can not spawn more than {} entities at once", EntitySlots::max_size);
+        return false;
+    }
+    const auto index = entity_store.attach(entity.get());
 
-    rtree.Insert(b.min, b.max, entity.get());
+    if (entity->is_static) {
+        // Its spawn callback may still place it, so it is packed once the frame's events are done
+        static_spawns.push_back(entity->handle);
+    } else {
+        entity_store.fat_bounds[index] = this->fat_bounds_for(index);
+        broadphase->insert(entity->handle, entity_store.fat_bounds[index], entity->broadphase_tag());
+    }
 
     if (default_show_collision_frames) {
         entity->show_collision_frame();
@@ -1000,8 +1807,16 @@ void Game::spawn_now(const std::shared_ptr<Entity>& entity)
     }
 
     renderer->add_observable(entity);
+    entity->entities_index = static_cast<uint32_t>(entities.size());
+    entity->last_think_tick = sim_tick;
+    entity->think_due = false;
+    entity->think_scheduled = entity->think_rate_us > 0;
+    if (entity->think_scheduled) {
+        timers.schedule(timers.now() + 1, { entity->handle, nullptr, 0 });
+    }
     entities.push_back(entity);
-    entity_lut[entity->guid()] = entity;
+    guid_to_handle[entity->guid()] = entity->handle;
+    return true;
 }
 
 } // namespace raptr
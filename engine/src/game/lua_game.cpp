@@ -23,6 +23,18 @@
 
 namespace {
 auto logger = raptr::_get_logger(__FILE__);
+
+//! Wrap a Lua function so that errors are logged instead of thrown into the tick
+std::function<void()> lua_timer_callback(sol::protected_function fn)
+{
+    return [fn]() {
+        auto result = fn();
+        if (!result.valid()) {
+            sol::error err = result;
+            logger->error("Timer callback failed: {}", err.what());
+        }
+    };
+}
 };
 
 namespace raptr {
@@ -80,6 +92,7 @@ void Game::setup_lua_context(sol::state& state)
     Character::setup_lua_context(state);
     Trigger::setup_lua_context(state);
     Renderer::setup_lua_context(state);
+    Map::setup_lua_context(state);
 
     sol::usertype<Game> gtable = state.new_usertype<Game>("Game");
 
@@ -87,12 +100,37 @@ void Game::setup_lua_context(sol::state& state)
     gtable["get_actor"] = &Game::get_entity<Actor>;
     gtable["get_entity"] = &Game::get_entity<Entity>;
     gtable["get_character"] = &Game::get_entity<Character>;
+    gtable["resolve"] = [](Game& game, uint32_t handle) { return game.resolve(EntityHandle { handle }); };
+    gtable["set_entity_name"] = &Game::set_entity_name;
     gtable["remove_entity_by_key"] = &Game::remove_entity_by_key;
     gtable["remove_entity"] = &Game::remove_entity;
     gtable["show_collision_frames"] = &Game::show_collision_frames;
     gtable["hide_collision_frames"] = &Game::hide_collision_frames;
     gtable["set_gravity"] = &Game::set_gravity;
+    gtable["set_tick_rate"] = &Game::set_tick_rate;
+    gtable["event_queue_depth"] = &Game::event_queue_depth;
+    gtable["event_queue_drops"] = &Game::event_queue_drops;
+    gtable["set_broadphase_margin"] = &Game::set_broadphase_margin;
+    gtable["broadphase_updates"] = &Game::broadphase_updates;
+    gtable["broadphase_reinserts"] = &Game::broadphase_reinserts;
+    gtable["broadphase_reinsert_rate"] = &Game::broadphase_reinsert_rate;
+    gtable["set_collision_filter"] = &Game::set_collision_filter;
     gtable["kill"] = &Game::kill_entity;
+    gtable["wake"] = &Game::wake;
+    gtable["after"] = [](Game& game, double ms, sol::protected_function fn) {
+        return game.after(static_cast<int64_t>(ms * 1e3), lua_timer_callback(fn));
+    };
+    gtable["every"] = [](Game& game, double ms, sol::protected_function fn) {
+        return game.every(static_cast<int64_t>(ms * 1e3), lua_timer_callback(fn));
+    };
+    gtable["cancel"] = &Game::cancel_timer;
+    gtable["fast_forward"] = [](Game& game, uint64_t ticks, sol::optional<int64_t> dt_us) {
+        return game.fast_forward(ticks, dt_us.value_or(0));
+    };
+    gtable["set_broadphase"] = [](Game& game, const std::string& kind, sol::optional<double> cell_size) {
+        return game.set_broadphase(kind, cell_size.value_or(game.config->broadphase_cell_size));
+    };
+    gtable["map"] = sol::readonly_property([](Game& game) { return game.map; });
     gtable["reload_map"] = [&](Game& game) {
         if (!game.map) {
             logger->error("There is no map to reload");
@@ -1,11 +1,20 @@
 #include <SDL_image.h>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
 #include <picojson.h>
 #include <sstream>
 
+#include <raptr/common/compression.hpp>
 #include <raptr/common/logging.hpp>
+#include <raptr/common/mapped_file.hpp>
+#include <raptr/config.hpp>
 #include <raptr/game/character.hpp>
 #include <raptr/game/game.hpp>
 #include <raptr/game/map.hpp>
+#include <raptr/game/map_format.hpp>
+#include <raptr/game/map_streamer.hpp>
 #include <raptr/renderer/renderer.hpp>
 #include <raptr/ui/dialog.hpp>
 
@@ -15,6 +24,65 @@ const uint32_t FLIPPED_HORIZONTALLY_FLAG = 1 << 31;
 const uint32_t FLIPPED_VERTICALLY_FLAG = 1 << 30;
 const uint32_t FLIPPED_DIAGONALLY_FLAG = 1 << 29;
 const uint32_t CLEAR_FLIP = ~(FLIPPED_HORIZONTALLY_FLAG | FLIPPED_VERTICALLY_FLAG | FLIPPED_DIAGONALLY_FLAG);
+
+//! Whether any part of a world box may be drawn by one of the camera clips
+bool is_visible(const raptr::Rect& box, const std::vector<raptr::CameraClip>& clips, int32_t window_h)
+{
+    // The clips are taken against the window height but drawn against the logical one, so
+    // allow for the difference on top of the 64px RenderableTexture::render allows
+    const double slack_x = 64;
+    const double slack_y = 64 + std::abs(raptr::GAME_HEIGHT - window_h);
+    if (clips.empty()) {
+        return true;
+    }
+
+    for (const auto& camera : clips) {
+        const double top = window_h - camera.clip.y;
+        const double bottom = top - camera.clip.h;
+        if (box.x + box.w < camera.clip.x - slack_x || box.x > camera.clip.x + camera.clip.w + slack_x) {
+            continue;
+        }
+        if (box.y + box.h < bottom - slack_y || box.y > top + slack_y) {
+            continue;
+        }
+        return true;
+    }
+    return false;
+}
+
+//! A cell holding a tile from its editor index, flip bits included
+raptr::TileCell make_cell(uint32_t tile_index, raptr::TileFlag flag)
+{
+    raptr::TileCell cell;
+    cell.gid = tile_index & CLEAR_FLIP;
+    cell.flag = static_cast<uint8_t>(flag);
+    if (tile_index & FLIPPED_HORIZONTALLY_FLAG) {
+        cell.bits |= raptr::TileCell::FlipX;
+    }
+    if (tile_index & FLIPPED_VERTICALLY_FLAG) {
+        cell.bits |= raptr::TileCell::FlipY;
+    }
+    if (tile_index & FLIPPED_DIAGONALLY_FLAG) {
+        cell.bits |= raptr::TileCell::Rotated;
+    }
+    return cell;
+}
+
+//! The editor index of a cell's tile, flip bits included
+uint32_t cell_index(const raptr::TileCell& cell)
+{
+    uint32_t index = cell.gid;
+    if (cell.bits & raptr::TileCell::FlipX) {
+        index |= FLIPPED_HORIZONTALLY_FLAG;
+    }
+    if (cell.bits & raptr::TileCell::FlipY) {
+        index |= FLIPPED_VERTICALLY_FLAG;
+    }
+    if (cell.bits & raptr::TileCell::Rotated) {
+        index |= FLIPPED_DIAGONALLY_FLAG;
+    }
+    return index;
+}
 };
 
 namespace raptr {
@@ -49,18 +117,80 @@ auto B = [&](const std::string& name, const picojson::value& ref) -> bool {
     return ref.get(name).get<bool>();
 };
 
-uint32_t find_max_tile_id(const picojson::array& layers)
+/*!
+  Read a tile layer's data into one index per cell. The data is either an
+  array of numbers, or base64 of little-endian 32-bit indices that may be
+  compressed, which is decompressed straight into the indices.
+*/
+bool read_layer_data(const picojson::value& pico_layer, std::vector<uint32_t>& indices)
+{
+    const auto name = S("name", pico_layer);
+    const auto& data = pico_layer.get("data");
+    if (data.is<picojson::array>()) {
+        const auto& layer_data = data.get<picojson::array>();
+        indices.resize(layer_data.size());
+        for (size_t i = 0; i < layer_data.size(); ++i) {
+            indices[i] = static_cast<uint32_t>(layer_data[i].get<double>());
+        }
+        return true;
+    }
+
+    const auto encoding = pico_layer.contains("encoding") ? S("encoding", pico_layer) : "csv";
+    const auto compression_name = pico_layer.contains("compression") ? S("compression", pico_layer) : "";
+    Compression compression;
+    if (encoding != "base64" || !data.is<std::string>()) {
+        logger->error("Layer {} has data encoded as {}, which is not supported", name, encoding);
+        return false;
+    }
+    if (!compression_from_name(compression_name, compression)) {
+        logger->error("Layer {} is compressed with {}, which is not supported", name, compression_name);
+        return false;
+    }
+
+    std::vector<uint8_t> bytes;
+    if (!base64_decode(data.get<std::string>(), bytes)) {
+        logger->error("Layer {} has data that is not valid base64", name);
+        return false;
+    }
+
+    indices.resize(static_cast<size_t>(U("width", pico_layer)) * U("height", pico_layer));
+    const auto out = reinterpret_cast<uint8_t*>(indices.data());
+    if (!decompress(compression, bytes.data(), bytes.size(), out, indices.size() * sizeof(uint32_t))) {
+        logger->error("Layer {} could not be decoded", name);
+        return false;
+    }
+
+    // The indices are little-endian whatever machine exported them
+    const uint32_t probe = 1;
+    if (*reinterpret_cast<const uint8_t*>(&probe) != 1) {
+        for (auto& index : indices) {
+            const auto b = reinterpret_cast<const uint8_t*>(&index);
+            index = b[0] | (b[1] << 8) | (b[2] << 16) | (static_cast<uint32_t>(b[3]) << 24);
+        }
+    }
+    return true;
+}
+
+//! Read the data of every tile layer, indexed like the layers; other layers are left empty
+bool read_tile_data(const picojson::array& layers, std::vector<std::vector<uint32_t>>& tile_data)
+{
+    tile_data.assign(layers.size(), {});
+    for (size_t i = 0; i < layers.size(); ++i) {
+        if (S("type", layers[i]) == "tilelayer" && !read_layer_data(layers[i], tile_data[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t find_max_tile_id(const picojson::array& layers, const std::vector<std::vector<uint32_t>>& tile_data)
 {
     uint32_t max_tile_id = 0;
-    for (auto& pico_layer : layers) {
+    for (size_t i = 0; i < layers.size(); ++i) {
+        const auto& pico_layer = layers[i];
         auto layer_type = S("type", pico_layer);
         if (layer_type == "tilelayer") {
-            auto layer_data = pico_layer.get("data").get<picojson::array>();
-            int k = 0;
-            for (auto d : layer_data) {
-                k++;
-                auto tile_id = static_cast<uint32_t>(d.get<double>());
-                auto original = tile_id;
+            for (auto tile_id : tile_data[i]) {
                 tile_id &= CLEAR_FLIP;
                 if (tile_id > max_tile_id) {
                     max_tile_id = tile_id;
@@ -83,11 +213,25 @@ uint32_t find_max_tile_id(const picojson::array& layers)
     return max_tile_id;
 }
 
-bool load_tileset(const picojson::value& tileset,
-    const FileInfo& folder,
-    const std::shared_ptr<Map>& map,
-    uint32_t max_tile_id)
+//! What a tileset says about one tile, before anything is loaded for it
+struct TileSource {
+    uint32_t gid;
 
+    //! Relative to the game root; empty for tiles that have properties instead of an image
+    std::string image;
+    std::string type;
+
+    //! The sprite json relative to the game root, for animated tiles
+    std::string animation;
+
+    //! The image size if the tileset records it, otherwise 0
+    int32_t width = 0, height = 0;
+};
+
+bool read_tileset(const picojson::value& tileset,
+    const FileInfo& folder,
+    uint32_t max_tile_id,
+    std::vector<TileSource>& out)
 {
     auto tile_off = U("firstgid", tileset);
     auto source_json = folder / S("source", tileset);
@@ -122,45 +266,76 @@ bool load_tileset(const picojson::value& tileset,
             continue;
         }
 
-        std::string source_tile_type = "Non-Collidable";
+        TileSource tile;
+        tile.gid = tile_off + key;
+        tile.type = "Non-Collidable";
         if (source_tile_params.contains("type")) {
-            source_tile_type = S("type", source_tile_params);
+            tile.type = S("type", source_tile_params);
         }
 
-        auto& tilemap = map->tilemap[tile_off + key];
-        tilemap.type = source_tile_type;
-        tilemap.src.x = 0;
-        tilemap.src.y = 0;
-        tilemap.src.w = 0;
-        tilemap.src.h = 0;
-
-        std::shared_ptr<Sprite> sprite = nullptr;
         auto has_properties = tile_properties.find(source_tile.first);
         if (has_properties != tile_properties.end()) {
             auto properties = has_properties->second.get<picojson::object>();
             auto has_animation = properties.find("animation");
             if (has_animation != properties.end()) {
-                const auto animation = has_animation->second.get<std::string>();
-                const auto animation_path = folder.from_root(animation);
-                sprite = Sprite::from_json(animation_path);
-                if (!sprite) {
-                    logger->error("Failed to load sprite: {}", animation_path);
-                    return false;
-                }
+                tile.animation = has_animation->second.get<std::string>();
             }
-            tilemap.sprite = sprite;
         } else {
-            auto source_tile_image_path = source_tile_image.file_path.string();
-            SDL_Surface* surface = IMG_Load(source_tile_image_path.c_str());
-            if (!surface) {
-                logger->error("Tileset at {} could not load {}", source_json, source_tile_image);
-                return false;
+            tile.image = source_tile_image.file_relative.generic_string();
+            if (source_tile_params.contains("imagewidth") && source_tile_params.contains("imageheight")) {
+                tile.width = I("imagewidth", source_tile_params);
+                tile.height = I("imageheight", source_tile_params);
             }
-            tilemap.surface.reset(surface, SDLDeleter());
-            tilemap.src.w = surface->w;
-            tilemap.src.h = surface->h;
         }
+
+        out.push_back(std::move(tile));
+    }
+    return true;
+}
+
+bool load_tile_source(const TileSource& source, const FileInfo& folder, const std::shared_ptr<Map>& map)
+{
+    auto& tilemap = map->tilemap[source.gid];
+    tilemap.type = source.type;
+    tilemap.flag = tile_flag_from_type(source.type);
+    tilemap.src.x = 0;
+    tilemap.src.y = 0;
+    tilemap.src.w = 0;
+    tilemap.src.h = 0;
+
+    if (!source.animation.empty()) {
+        const auto animation_path = folder.from_root(source.animation);
+        tilemap.sprite = Sprite::from_json(animation_path);
+        if (!tilemap.sprite) {
+            logger->error("Failed to load sprite: {}", animation_path);
+            return false;
+        }
+        return true;
+    }
+
+    if (source.image.empty()) {
+        return true;
+    }
+
+    tilemap.image = folder.from_root(source.image).file_path.string();
+    if (map->streamer && source.width > 0 && source.height > 0) {
+        // The size is all that is needed until a chunk near a player uses the tile
+        tilemap.streamed = true;
+        tilemap.src.w = source.width;
+        tilemap.src.h = source.height;
+        return true;
     }
+
+    SDL_Surface* surface = IMG_Load(tilemap.image.c_str());
+    if (!surface) {
+        logger->error("Could not load tile image {}", source.image);
+        return false;
+    }
+    tilemap.surface.reset(surface, SDLDeleter());
+    tilemap.src.w = surface->w;
+    tilemap.src.h = surface->h;
+    tilemap.masks = CollisionMasks::from_pixels(reinterpret_cast<const uint8_t*>(surface->pixels),
+        surface->pitch, surface->format->BytesPerPixel, surface->w, surface->h);
     return true;
 }
 
@@ -221,6 +396,7 @@ bool load_dialog(const picojson::value& layer,
     obj.sprite = sprite;
     obj.dialog = dialog;
     obj.type = "Interactive";
+    obj.flag = TileFlag::Interactive;
 
     auto width = U("width", object);
     auto height = U("height", object);
@@ -258,6 +434,7 @@ bool load_lua_script(const picojson::value& layer,
     obj.script = script;
     obj.sprite = sprite;
     obj.type = "Interactive";
+    obj.flag = TileFlag::Interactive;
 
     auto width = U("width", object);
     auto height = U("height", object);
@@ -297,48 +474,22 @@ bool load_tile(uint32_t tilemap_idx, uint32_t tile_index, uint32_t tile_offset,
     int32_t x, int32_t y, Layer& layer, const std::shared_ptr<Map>& map)
 {
     auto& tile = map->tilemap[tilemap_idx];
-    if (!tile.surface && !tile.sprite) {
+    if (tile.image.empty() && !tile.sprite) {
         logger->error("Tile surface was not allocated!");
         DebugBreak();
         return false;
     }
 
-    LayerTile l;
-    l.index = tile_index;
-    l.dst.x = (layer.x + x) * map->tile_width;
-    l.dst.y = (layer.height - y - layer.y - 1) * map->tile_height;
-    l.dst.w = tile.src.w;
-    l.dst.h = tile.src.h;
-    l.flip_x = false;
-    l.flip_y = false;
-    l.flip_x = tile_index & FLIPPED_HORIZONTALLY_FLAG;
-    l.flip_y = tile_index & FLIPPED_VERTICALLY_FLAG;
-    l.rotation_deg = 0.0;
-    if (tile_index & FLIPPED_DIAGONALLY_FLAG) {
-        l.rotation_deg = 90.0;
-    }
-
-    l.tile = &map->tilemap[tilemap_idx];
-    l.type = l.tile->type;
-
-    if (l.tile->sprite) {
-        l.sprite = l.tile->sprite->clone();
-        l.sprite->flip_x = l.flip_x;
-        l.sprite->flip_y = l.flip_y;
-        l.sprite->rotation_deg = l.rotation_deg;
-        l.sprite->x = l.dst.x;
-        l.sprite->y = l.dst.y;
-    }
-
-    layer.renderable.emplace_back(l);
-    layer.layer_tile_lut[tile_offset] = l;
-    return true;
+    return map->place_tile(layer, x, y, tile_index);
 }
 
-bool load_tilelayer(const picojson::value& pico_layer, const FileInfo& folder,
-    const std::shared_ptr<Map>& map)
+/*!
+  Read a tile layer's placement and check its data, as read by read_tile_data,
+  covers it. The Player layer only marks the spawn point, so it sets that.
+*/
+bool read_tilelayer(const picojson::value& pico_layer, const std::vector<uint32_t>& indices,
+    const std::shared_ptr<Map>& map, Layer& layer)
 {
-    Layer layer;
     layer.height = U("height", pico_layer);
     layer.width = U("width", pico_layer);
     layer.name = S("name", pico_layer);
@@ -346,10 +497,8 @@ bool load_tilelayer(const picojson::value& pico_layer, const FileInfo& folder,
     layer.y = I("y", pico_layer);
 
     if (layer.name == "Player") {
-        auto layer_data = pico_layer.get("data").get<picojson::array>();
         int32_t k = 0;
-        for (auto d : layer_data) {
-            auto tile_id = static_cast<uint32_t>(d.get<double>());
+        for (auto tile_id : indices) {
             auto tilemap_idx = tile_id & CLEAR_FLIP;
             if (tilemap_idx == 0) {
                 ++k;
@@ -364,37 +513,271 @@ bool load_tilelayer(const picojson::value& pico_layer, const FileInfo& folder,
 
     layer.is_foreground = false;
 
-    auto layer_data = pico_layer.get("data").get<picojson::array>();
-    for (auto d : layer_data) {
-        auto tile_id = static_cast<uint32_t>(d.get<double>());
-        auto tilemap_idx = tile_id & CLEAR_FLIP;
-        layer.data.push_back(tile_id);
-        layer.tile_table.push_back(tilemap_idx);
+    if (indices.size() != static_cast<size_t>(layer.width) * layer.height) {
+        logger->error("Layer {} has {} tiles, expected {}x{}", layer.name, indices.size(), layer.width, layer.height);
+        return false;
     }
+    return true;
+}
 
+bool load_tilelayer(const picojson::value& pico_layer, const std::vector<uint32_t>& indices,
+    const FileInfo& folder, const std::shared_ptr<Map>& map)
+{
+    Layer layer;
+    if (!read_tilelayer(pico_layer, indices, map, layer)) {
+        return false;
+    }
+    if (layer.name == "Player") {
+        return true;
+    }
+
+    layer.cells.resize(indices.size());
     for (uint32_t y = 0; y < layer.height; ++y) {
         for (uint32_t x = 0; x < layer.width; ++x) {
             uint32_t tile_offset = y * layer.width + x;
-            uint32_t tile_index = layer.data[tile_offset];
-            if (tile_index == 0) {
+            auto tile_index = indices[tile_offset];
+            uint32_t tilemap_idx = tile_index & CLEAR_FLIP;
+            if (tilemap_idx == 0) {
                 continue;
             }
-            uint32_t tilemap_idx = tile_index & CLEAR_FLIP;
             if (!load_tile(tilemap_idx, tile_index, tile_offset, x, y, layer, map)) {
                 return false;
             }
         }
     }
 
+    map->build_chunks(layer);
+
     map->layers.push_back(layer);
     return true;
 }
 
+std::shared_ptr<Map> load_compiled(const FileInfo& compiled, const FileInfo& folder, const std::shared_ptr<Config>& config)
+{
+    const auto file = MappedFile::open(compiled.file_path);
+    if (!file) {
+        return nullptr;
+    }
+
+    const uint8_t* data = file->data();
+    const uint64_t size = file->size();
+
+    CompiledMapHeader header;
+    if (size < sizeof(header)) {
+        logger->error("{} is too small to be a compiled map", compiled);
+        return nullptr;
+    }
+    std::memcpy(&header, data, sizeof(header));
+
+    if (header.magic != CompiledMapMagic || header.version != CompiledMapVersion || header.byte_order != CompiledMapByteOrder) {
+        logger->warn("{} was compiled by a different version or on a different platform", compiled);
+        return nullptr;
+    }
+
+    const auto in_file = [&](uint64_t offset, uint64_t bytes) {
+        return offset <= size && bytes <= size - offset;
+    };
+    const auto section_ok = [&](const CompiledSection& section, uint64_t record_size) {
+        return in_file(section.offset, section.size) && (record_size == 0 || section.size == section.count * record_size);
+    };
+
+    const auto grid_cells = static_cast<uint64_t>(std::max(header.grid_width, 0)) * std::max(header.grid_height, 0);
+    if (!section_ok(header.strings, 0) || !section_ok(header.tiles, sizeof(CompiledTile))
+        || !section_ok(header.layers, sizeof(CompiledLayer)) || !section_ok(header.objects, sizeof(uint32_t))
+        || !section_ok(header.grid, 0) || header.grid.size != grid_cells || header.tiles.count == 0
+        || !section_ok(header.sources, sizeof(uint32_t))
+        || (header.strings.size > 0 && data[header.strings.offset + header.strings.size - 1] != 0)) {
+        logger->error("{} is truncated or corrupt", compiled);
+        return nullptr;
+    }
+
+    // Every string ends inside the table, so any offset into it is a valid string
+    bool corrupt = false;
+    const auto string_at = [&](uint32_t offset) -> std::string {
+        if (offset == CompiledMapNoString) {
+            return {};
+        }
+        if (offset >= header.strings.size) {
+            corrupt = true;
+            return {};
+        }
+        return reinterpret_cast<const char*>(data + header.strings.offset + offset);
+    };
+
+    // Tile types, the collision grid and image sizes were baked in from these files
+    const auto compiled_time = fs::last_write_time(compiled.file_path);
+    for (uint32_t i = 0; i < header.sources.count; ++i) {
+        uint32_t offset;
+        std::memcpy(&offset, data + header.sources.offset + i * sizeof(uint32_t), sizeof(offset));
+
+        const auto source = folder.from_root(string_at(offset));
+        if (corrupt) {
+            logger->error("{} is truncated or corrupt", compiled);
+            return nullptr;
+        }
+        if (!fs::exists(source.file_path) || fs::last_write_time(source.file_path) > compiled_time) {
+            logger->warn("{} has changed since {} was compiled", source, compiled);
+            return nullptr;
+        }
+    }
+
+    const auto map = std::make_shared<Map>();
+    map->height = header.height;
+    map->width = header.width;
+    map->tile_height = header.tile_height;
+    map->tile_width = header.tile_width;
+    map->tilemap_texture_allocated = false;
+    map->player_spawn.x = header.spawn_x;
+    map->player_spawn.y = header.spawn_y;
+    map->tilemap.resize(header.tiles.count);
+
+    if (config && config->stream_radius_px > 0) {
+        map->streamer = std::make_unique<MapStreamer>(*map, *config);
+    }
+
+    for (uint32_t gid = 0; gid < header.tiles.count; ++gid) {
+        CompiledTile record;
+        std::memcpy(&record, data + header.tiles.offset + gid * sizeof(CompiledTile), sizeof(record));
+
+        // Tiles no tileset defines were never written
+        if (record.type == CompiledMapNoString) {
+            continue;
+        }
+
+        TileSource source;
+        source.gid = gid;
+        source.image = string_at(record.image);
+        source.type = string_at(record.type);
+        source.animation = string_at(record.animation);
+        source.width = record.width;
+        source.height = record.height;
+        if (corrupt || !load_tile_source(source, folder, map)) {
+            logger->error("{} could not load tile {}", compiled, gid);
+            return nullptr;
+        }
+    }
+
+    for (uint32_t i = 0; i < header.objects.count; ++i) {
+        uint32_t offset;
+        std::memcpy(&offset, data + header.objects.offset + i * sizeof(uint32_t), sizeof(offset));
+
+        picojson::value object;
+        const auto err = picojson::parse(object, string_at(offset));
+        if (corrupt || !err.empty() || !load_object(picojson::value(), object, folder, map)) {
+            logger->error("{} could not load object {}", compiled, i);
+            return nullptr;
+        }
+    }
+
+    for (uint32_t i = 0; i < header.layers.count; ++i) {
+        CompiledLayer record;
+        std::memcpy(&record, data + header.layers.offset + i * sizeof(CompiledLayer), sizeof(record));
+
+        Layer layer;
+        layer.name = string_at(record.name);
+        layer.x = record.x;
+        layer.y = record.y;
+        layer.width = record.width;
+        layer.height = record.height;
+        layer.is_foreground = false;
+
+        const auto cell_count = static_cast<uint64_t>(layer.width) * layer.height;
+        if (corrupt || !in_file(record.cells_offset, cell_count * sizeof(TileCell))) {
+            logger->error("{} has a corrupt layer {}", compiled, i);
+            return nullptr;
+        }
+
+        layer.cells.resize(cell_count);
+        std::memcpy(layer.cells.data(), data + record.cells_offset, cell_count * sizeof(TileCell));
+
+        // Plain tiles are ready as they are; animated ones still need their own sprite
+        for (uint32_t row = 0; row < layer.height; ++row) {
+            for (uint32_t x = 0; x < layer.width; ++x) {
+                auto& cell = layer.cells[static_cast<size_t>(row) * layer.width + x];
+                cell.special = 0;
+                if (cell.gid == 0) {
+                    continue;
+                }
+                if (cell.gid >= map->tilemap.size()) {
+                    logger->error("{} places tile {}, which is not in its tile table", compiled, cell.gid);
+                    return nullptr;
+                }
+
+                const auto& tile = map->tilemap[cell.gid];
+                cell.flag = static_cast<uint8_t>(tile.flag);
+                if (tile.sprite) {
+                    if (!map->place_tile(layer, x, row, cell_index(cell))) {
+                        return nullptr;
+                    }
+                } else if (tile.image.empty()) {
+                    logger->error("Tile surface was not allocated!");
+                    return nullptr;
+                }
+            }
+        }
+
+        map->build_chunks(layer);
+        map->layers.push_back(std::move(layer));
+    }
+
+    map->grid.x = header.grid_x;
+    map->grid.y = header.grid_y;
+    map->grid.width = std::max(header.grid_width, 0);
+    map->grid.height = std::max(header.grid_height, 0);
+    map->grid.cells.assign(data + header.grid.offset, data + header.grid.offset + header.grid.size);
+    map->build_grid_chunks();
+
+    logger->info("Loaded compiled map {}", compiled);
+    return map;
+}
+
+//! Gathers the strings of a compiled map, storing each distinct string once
+class StringTable {
+public:
+    uint32_t add(const std::string& value)
+    {
+        if (value.empty()) {
+            return CompiledMapNoString;
+        }
+
+        const auto found = offsets.find(value);
+        if (found != offsets.end()) {
+            return found->second;
+        }
+
+        const auto offset = static_cast<uint32_t>(bytes.size());
+        bytes.insert(bytes.end(), value.begin(), value.end());
+        bytes.push_back('\0');
+        offsets.emplace(value, offset);
+        return offset;
+    }
+
+    std::vector<char> bytes;
+
+private:
+    std::map<std::string, uint32_t> offsets;
+};
+
 }
 
-std::shared_ptr<Map> Map::load(const FileInfo& folder)
+Map::~Map() = default;
+
+std::shared_ptr<Map> Map::load(const FileInfo& folder, const std::shared_ptr<Config>& config)
 {
     auto map_json = folder / "map.json";
+
+    // A compiled map is read in place, unless the export or a tileset has been changed since it was compiled
+    auto map_compiled = folder / "map.rmap";
+    if (fs::exists(map_compiled.file_path)) {
+        if (fs::exists(map_json.file_path) && fs::last_write_time(map_json.file_path) > fs::last_write_time(map_compiled.file_path)) {
+            logger->warn("{} is older than {}, loading the json instead", map_compiled, map_json);
+        } else if (auto map = parser::load_compiled(map_compiled, folder, config)) {
+            return map;
+        } else {
+            logger->warn("Falling back to {}", map_json);
+        }
+    }
+
     auto input = map_json.open();
 
     if (!input) {
@@ -420,18 +803,35 @@ std::shared_ptr<Map> Map::load(const FileInfo& folder)
     map->tilemap_texture_allocated = false;
 
     // The layers represent both objects and tiles
-    auto layers = doc.get("layers").get<picojson::array>();
+    const auto& layers = doc.get("layers").get<picojson::array>();
+
+    // Tile data is decoded once, as it may be compressed
+    std::vector<std::vector<uint32_t>> tile_data;
+    if (!parser::read_tile_data(layers, tile_data)) {
+        return nullptr;
+    }
 
     // We create a very sparse representation of the tiles by
     // finding the maximum tile id through the entire loaded map
-    const auto max_tile_id = parser::find_max_tile_id(layers);
+    const auto max_tile_id = parser::find_max_tile_id(layers, tile_data);
     map->tilemap.resize(max_tile_id + 1);
 
+    if (config && config->stream_radius_px > 0) {
+        map->streamer = std::make_unique<MapStreamer>(*map, *config);
+    }
+
     // Iterate through each of the tilesets in the map and load
     // them into the map->tilemap property
+    std::vector<parser::TileSource> tile_sources;
     auto tileset_data = doc.get("tilesets").get<picojson::array>();
     for (auto& tileset : tileset_data) {
-        if (!parser::load_tileset(tileset, folder, map, max_tile_id)) {
+        if (!parser::read_tileset(tileset, folder, max_tile_id, tile_sources)) {
+            return nullptr;
+        }
+    }
+
+    for (const auto& source : tile_sources) {
+        if (!parser::load_tile_source(source, folder, map)) {
             return nullptr;
         }
     }
@@ -455,195 +855,611 @@ std::shared_ptr<Map> Map::load(const FileInfo& folder)
     // the map. These are fixed at a tile_width / tile_height grid and
     // have limited (or rather well defined) actions in the world
     bool is_foreground = true;
-    for (auto& pico_layer : layers) {
+    for (size_t i = 0; i < layers.size(); ++i) {
+        const auto& pico_layer = layers[i];
         auto layer_type = S("type", pico_layer);
         if (layer_type != "tilelayer") {
             continue;
         }
-        if (!parser::load_tilelayer(pico_layer, folder, map)) {
+        if (!parser::load_tilelayer(pico_layer, tile_data[i], folder, map)) {
             logger->error("Failed to load tile layer");
             return nullptr;
         }
     }
 
+    map->build_collision_grid();
+
     return map;
 }
 
+bool Map::compile(const FileInfo& folder, const fs::path& output)
+{
+    auto map_json = folder / "map.json";
+    auto input = map_json.open();
+    if (!input) {
+        return false;
+    }
+
+    picojson::value doc;
+    *input >> doc;
+    if (!picojson::get_last_error().empty()) {
+        logger->error("{} is not valid json: {}", map_json, picojson::get_last_error());
+        return false;
+    }
+
+    using parser::S;
+    using parser::U;
+
+    // The map is only read as far as its cells and collision grid; no image is kept
+    const auto map = std::make_shared<Map>();
+    map->height = U("height", doc);
+    map->width = U("width", doc);
+    map->tile_height = U("tileheight", doc);
+    map->tile_width = U("tilewidth", doc);
+    map->player_spawn = Rect(0, 0, 0, 0);
+
+    const auto& layers = doc.get("layers").get<picojson::array>();
+    std::vector<std::vector<uint32_t>> tile_data;
+    if (!parser::read_tile_data(layers, tile_data)) {
+        return false;
+    }
+
+    const auto max_tile_id = parser::find_max_tile_id(layers, tile_data);
+    map->tilemap.resize(max_tile_id + 1);
+
+    parser::StringTable strings;
+    std::vector<uint32_t> sources;
+
+    std::vector<parser::TileSource> tile_sources;
+    for (auto& tileset : doc.get("tilesets").get<picojson::array>()) {
+        if (!parser::read_tileset(tileset, folder, max_tile_id, tile_sources)) {
+            return false;
+        }
+        sources.push_back(strings.add((folder / S("source", tileset)).file_relative.generic_string()));
+    }
+
+    std::vector<CompiledTile> tiles(map->tilemap.size(), { CompiledMapNoString, CompiledMapNoString, CompiledMapNoString, 0, 0 });
+    for (const auto& source : tile_sources) {
+        auto width = source.width;
+        auto height = source.height;
+
+        // Record the size once here so a streamed tile never has to be decoded to be placed
+        if (!source.image.empty() && (width <= 0 || height <= 0)) {
+            const auto path = folder.from_root(source.image).file_path.string();
+            SDL_Surface* surface = IMG_Load(path.c_str());
+            if (!surface) {
+                logger->error("Could not load tile image {}", source.image);
+                return false;
+            }
+            width = surface->w;
+            height = surface->h;
+            SDL_FreeSurface(surface);
+            sources.push_back(strings.add(source.image));
+        }
+
+        auto& tile = map->tilemap[source.gid];
+        tile.type = source.type;
+        tile.flag = tile_flag_from_type(source.type);
+        tiles[source.gid] = { strings.add(source.image), strings.add(source.type), strings.add(source.animation), width, height };
+    }
+
+    std::vector<uint32_t> objects;
+    for (auto& pico_layer : layers) {
+        if (S("type", pico_layer) != "objectgroup") {
+            continue;
+        }
+        for (auto& object : pico_layer.get("objects").get<picojson::array>()) {
+            objects.push_back(strings.add(object.serialize()));
+        }
+    }
+
+    std::vector<CompiledLayer> layer_records;
+    for (size_t l = 0; l < layers.size(); ++l) {
+        const auto& pico_layer = layers[l];
+        if (S("type", pico_layer) != "tilelayer") {
+            continue;
+        }
+
+        Layer layer;
+        const auto& indices = tile_data[l];
+        if (!parser::read_tilelayer(pico_layer, indices, map, layer)) {
+            return false;
+        }
+        if (layer.name == "Player") {
+            continue;
+        }
+
+        layer.cells.resize(indices.size());
+        for (size_t i = 0; i < indices.size(); ++i) {
+            const auto gid = indices[i] & CLEAR_FLIP;
+            if (gid != 0) {
+                layer.cells[i] = make_cell(indices[i], map->tilemap[gid].flag);
+            }
+        }
+
+        CompiledLayer record {};
+        record.name = strings.add(layer.name);
+        record.x = layer.x;
+        record.y = layer.y;
+        record.width = layer.width;
+        record.height = layer.height;
+        layer_records.push_back(record);
+        map->layers.push_back(std::move(layer));
+    }
+
+    map->build_collision_grid();
+
+    // Lay the sections out after the header, each on an 8-byte boundary
+    std::vector<uint8_t> out(sizeof(CompiledMapHeader), 0);
+    const auto append = [&out](const void* bytes, size_t count) -> uint64_t {
+        out.resize((out.size() + 7) & ~static_cast<size_t>(7), 0);
+        const auto offset = out.size();
+        out.insert(out.end(), static_cast<const uint8_t*>(bytes), static_cast<const uint8_t*>(bytes) + count);
+        return offset;
+    };
+
+    CompiledMapHeader header {};
+    header.magic = CompiledMapMagic;
+    header.version = CompiledMapVersion;
+    header.byte_order = CompiledMapByteOrder;
+    header.width = map->width;
+    header.height = map->height;
+    header.tile_width = map->tile_width;
+    header.tile_height = map->tile_height;
+    header.spawn_x = map->player_spawn.x;
+    header.spawn_y = map->player_spawn.y;
+
+    header.strings = { append(strings.bytes.data(), strings.bytes.size()), strings.bytes.size(), 0, 0 };
+    header.tiles = { append(tiles.data(), tiles.size() * sizeof(CompiledTile)), tiles.size() * sizeof(CompiledTile), static_cast<uint32_t>(tiles.size()), 0 };
+
+    // The layer table points at the cells, so it is filled in once they have been placed
+    const auto layers_size = layer_records.size() * sizeof(CompiledLayer);
+    header.layers = { append(layer_records.data(), layers_size), layers_size, static_cast<uint32_t>(layer_records.size()), 0 };
+    for (size_t i = 0; i < layer_records.size(); ++i) {
+        const auto& cells = map->layers[i].cells;
+        layer_records[i].cells_offset = append(cells.data(), cells.size() * sizeof(TileCell));
+    }
+    if (layers_size > 0) {
+        std::memcpy(out.data() + header.layers.offset, layer_records.data(), layers_size);
+    }
+
+    header.objects = { append(objects.data(), objects.size() * sizeof(uint32_t)), objects.size() * sizeof(uint32_t), static_cast<uint32_t>(objects.size()), 0 };
+    header.grid = { append(map->grid.cells.data(), map->grid.cells.size()), map->grid.cells.size(), 0, 0 };
+    header.grid_x = map->grid.x;
+    header.grid_y = map->grid.y;
+    header.grid_width = map->grid.width;
+    header.grid_height = map->grid.height;
+    header.sources = { append(sources.data(), sources.size() * sizeof(uint32_t)), sources.size() * sizeof(uint32_t), static_cast<uint32_t>(sources.size()), 0 };
+    std::memcpy(out.data(), &header, sizeof(header));
+
+    std::ofstream file(output, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(out.data()), out.size());
+    if (!file) {
+        logger->error("Could not write {}", output);
+        return false;
+    }
+
+    logger->info("Compiled {} into {} ({} bytes, {} layers, {} tiles)", map_json, output, out.size(), layer_records.size(), tiles.size());
+    return true;
+}
+
+void Map::build_collision_grid()
+{
+    grid = CollisionGrid();
+    if (layers.empty()) {
+        return;
+    }
+
+    int32_t x0 = layers.front().x;
+    int32_t y0 = layers.front().y;
+    int32_t x1 = x0;
+    int32_t y1 = y0;
+    for (const auto& layer : layers) {
+        x0 = std::min(x0, layer.x);
+        y0 = std::min(y0, layer.y);
+        x1 = std::max(x1, layer.x + static_cast<int32_t>(layer.width));
+        y1 = std::max(y1, layer.y + static_cast<int32_t>(layer.height));
+    }
+
+    grid.x = x0;
+    grid.y = y0;
+    grid.width = x1 - x0;
+    grid.height = y1 - y0;
+    grid.cells.assign(static_cast<size_t>(grid.width) * grid.height, 0);
+
+    for (const auto& layer : layers) {
+        for (uint32_t row = 0; row < layer.height; ++row) {
+            // Layer rows run top down, the grid bottom up
+            const auto cy = layer.y + static_cast<int32_t>(layer.height - row - 1);
+            const TileCell* cells = &layer.cells[static_cast<size_t>(row) * layer.width];
+            uint8_t* out = &grid.cells[static_cast<size_t>(cy - grid.y) * grid.width + (layer.x - grid.x)];
+            for (uint32_t x = 0; x < layer.width; ++x) {
+                out[x] |= cells[x].flag;
+            }
+        }
+    }
+
+    this->build_grid_chunks();
+}
+
+void Map::build_grid_chunks()
+{
+    grid.chunks_wide = (grid.width + TileChunkSize - 1) / TileChunkSize;
+    const auto chunks_high = (grid.height + TileChunkSize - 1) / TileChunkSize;
+    grid.chunk_flags.assign(static_cast<size_t>(grid.chunks_wide) * chunks_high, 0);
+    for (int32_t cy = grid.y; cy < grid.y + grid.height; ++cy) {
+        for (int32_t cx = grid.x; cx < grid.x + grid.width; ++cx) {
+            grid.chunk_flags[grid.chunk_of(cx, cy)] |= grid.at(cx, cy);
+        }
+    }
+}
+
+void Map::build_chunks(Layer& layer)
+{
+    layer.chunks_wide = (layer.width + TileChunkSize - 1) / TileChunkSize;
+    const auto chunks_high = (layer.height + TileChunkSize - 1) / TileChunkSize;
+    layer.chunks.assign(static_cast<size_t>(layer.chunks_wide) * chunks_high, TileChunk());
+    for (uint32_t chunk = 0; chunk < layer.chunks.size(); ++chunk) {
+        // Streamed chunks become resident once a player comes near
+        layer.chunks[chunk].resident = !streamer;
+        this->refresh_chunk(layer, chunk);
+    }
+}
+
+void Map::refresh_chunk(Layer& layer, uint32_t chunk)
+{
+    const auto x0 = (chunk % layer.chunks_wide) * TileChunkSize;
+    const auto row0 = (chunk / layer.chunks_wide) * TileChunkSize;
+    const auto x1 = std::min(x0 + TileChunkSize, layer.width);
+    const auto row1 = std::min(row0 + TileChunkSize, layer.height);
+
+    auto& info = layer.chunks[chunk];
+    const auto resident = info.resident;
+    info = TileChunk();
+    info.resident = resident;
+
+    // Tiles can be larger than a cell, so the bounds cover what is drawn rather than the cells
+    double min_x = 0, min_y = 0, max_x = 0, max_y = 0;
+    for (auto row = row0; row < row1; ++row) {
+        for (auto x = x0; x < x1; ++x) {
+            const auto& cell = layer.cells[static_cast<size_t>(row) * layer.width + x];
+            if (cell.gid == 0) {
+                continue;
+            }
+
+            const auto& tile = tilemap[cell.gid];
+            const double left = (layer.x + static_cast<int32_t>(x)) * static_cast<double>(tile_width);
+            const double bottom = (static_cast<int32_t>(layer.height - row) - layer.y - 1) * static_cast<double>(tile_height);
+            const double right = left + tile.src.w;
+            const double top = bottom + tile.src.h;
+
+            if (info.count == 0) {
+                min_x = left;
+                min_y = bottom;
+                max_x = right;
+                max_y = top;
+            } else {
+                min_x = std::min(min_x, left);
+                min_y = std::min(min_y, bottom);
+                max_x = std::max(max_x, right);
+                max_y = std::max(max_y, top);
+            }
+
+            info.flags |= cell.flag;
+            ++info.count;
+        }
+    }
+
+    info.bounds = Rect(min_x, min_y, max_x - min_x, max_y - min_y);
+}
+
+void Map::refresh_grid_cell(int32_t cx, int32_t cy)
+{
+    if (cx < grid.x || cy < grid.y || cx >= grid.x + grid.width || cy >= grid.y + grid.height) {
+        return;
+    }
+
+    uint8_t flags = 0;
+    for (const auto& layer : layers) {
+        const auto x = cx - layer.x;
+        const auto y = cy - layer.y;
+        if (x < 0 || y < 0 || x >= static_cast<int32_t>(layer.width) || y >= static_cast<int32_t>(layer.height)) {
+            continue;
+        }
+        flags |= layer.cells[static_cast<size_t>(layer.height - y - 1) * layer.width + x].flag;
+    }
+    grid.cells[static_cast<size_t>(cy - grid.y) * grid.width + (cx - grid.x)] = flags;
+
+    // Merge the whole grid chunk again, since the flag may have been the chunk's last
+    const auto chunk = grid.chunk_of(cx, cy);
+    const auto chunk_x = grid.x + static_cast<int32_t>((chunk % grid.chunks_wide) * TileChunkSize);
+    const auto chunk_y = grid.y + static_cast<int32_t>((chunk / grid.chunks_wide) * TileChunkSize);
+    uint8_t chunk_flags = 0;
+    for (auto y = chunk_y; y < chunk_y + static_cast<int32_t>(TileChunkSize); ++y) {
+        for (auto x = chunk_x; x < chunk_x + static_cast<int32_t>(TileChunkSize); ++x) {
+            chunk_flags |= grid.at(x, y);
+        }
+    }
+    grid.chunk_flags[chunk] = chunk_flags;
+}
+
+bool Map::place_tile(Layer& layer, uint32_t x, uint32_t row, uint32_t tile_index)
+{
+    if (x >= layer.width || row >= layer.height) {
+        logger->error("{},{} is outside of layer {}", x, row, layer.name);
+        return false;
+    }
+
+    const auto gid = tile_index & CLEAR_FLIP;
+    if (gid >= tilemap.size() || (gid != 0 && tilemap[gid].image.empty() && !tilemap[gid].sprite)) {
+        logger->error("Tile {} is not loaded by map {}", gid, name);
+        return false;
+    }
+
+    auto& cell = layer.cells[static_cast<size_t>(row) * layer.width + x];
+    const auto old_gid = cell.gid;
+    const auto old_special = cell.special;
+
+    // Check for room before anything changes, so a failed placement leaves the cell as it was
+    const bool animated = gid != 0 && tilemap[gid].sprite;
+    if (animated && !old_special && layer.free_special.empty() && layer.special.size() >= std::numeric_limits<uint16_t>::max()) {
+        logger->error("Layer {} has more than {} animated tiles", layer.name, layer.special.size());
+        return false;
+    }
+    cell = TileCell();
+
+    // A resident chunk keeps the images of its tiles loaded
+    if (streamer && !layer.chunks.empty() && layer.chunks[layer.chunk_of(x, row)].resident) {
+        if (gid != 0) {
+            streamer->retain(gid);
+        }
+        if (old_gid != 0) {
+            streamer->release(old_gid);
+        }
+    }
+
+    // Drop what the old tile held and hand its side table slot back
+    if (old_special) {
+        layer.special[old_special - 1] = LayerTile();
+        layer.free_special.push_back(old_special);
+    }
+
+    if (gid != 0) {
+        auto& tile = tilemap[gid];
+        cell = make_cell(tile_index, tile.flag);
+
+        // Plain tiles are drawn straight from the cell; animated ones need a sprite of their own
+        if (animated) {
+            LayerTile l;
+            l.index = tile_index;
+            l.dst.x = (layer.x + static_cast<int32_t>(x)) * tile_width;
+            l.dst.y = (static_cast<int32_t>(layer.height - row) - layer.y - 1) * tile_height;
+            l.dst.w = tile.src.w;
+            l.dst.h = tile.src.h;
+            l.flip_x = (cell.bits & TileCell::FlipX) != 0;
+            l.flip_y = (cell.bits & TileCell::FlipY) != 0;
+            l.rotation_deg = (cell.bits & TileCell::Rotated) ? 90.0f : 0.0f;
+            l.tile = &tile;
+            l.type = tile.type;
+            l.flag = tile.flag;
+
+            l.sprite = tile.sprite->clone();
+            l.sprite->flip_x = l.flip_x;
+            l.sprite->flip_y = l.flip_y;
+            l.sprite->rotation_deg = l.rotation_deg;
+            l.sprite->x = l.dst.x;
+            l.sprite->y = l.dst.y;
+
+            if (!layer.free_special.empty()) {
+                cell.special = layer.free_special.back();
+                layer.free_special.pop_back();
+                layer.special[cell.special - 1] = std::move(l);
+            } else {
+                layer.special.push_back(std::move(l));
+                cell.special = static_cast<uint16_t>(layer.special.size());
+            }
+        }
+    }
+
+    // While a map loads its chunks and grid are built once at the end instead
+    if (!layer.chunks.empty()) {
+        this->refresh_chunk(layer, layer.chunk_of(x, row));
+    }
+    if (!grid.cells.empty()) {
+        this->refresh_grid_cell(layer.x + static_cast<int32_t>(x), layer.y + static_cast<int32_t>(layer.height - row - 1));
+    }
+    return true;
+}
+
+Layer* Map::find_layer(const std::string& layer_name)
+{
+    for (auto& layer : layers) {
+        if (layer.name == layer_name) {
+            return &layer;
+        }
+    }
+    return nullptr;
+}
+
+bool Map::set_tile(const std::string& layer_name, uint32_t x, uint32_t row, uint32_t tile_index)
+{
+    auto layer = this->find_layer(layer_name);
+    if (!layer) {
+        logger->error("Map {} has no layer named {}", name, layer_name);
+        return false;
+    }
+
+    std::scoped_lock<std::mutex> lck(mutex);
+    return this->place_tile(*layer, x, row, tile_index);
+}
+
+uint32_t Map::get_tile(const std::string& layer_name, uint32_t x, uint32_t row)
+{
+    auto layer = this->find_layer(layer_name);
+    if (!layer || x >= layer->width || row >= layer->height) {
+        return 0;
+    }
+    return layer->cells[static_cast<size_t>(row) * layer->width + x].gid;
+}
+
+void Map::setup_lua_context(sol::state& state)
+{
+    state.new_usertype<Map>("Map",
+        "name", sol::readonly(&Map::name),
+        "width", sol::readonly(&Map::width),
+        "height", sol::readonly(&Map::height),
+        "tile_width", sol::readonly(&Map::tile_width),
+        "tile_height", sol::readonly(&Map::tile_height),
+        "set_tile", &Map::set_tile,
+        "get_tile", &Map::get_tile,
+        "clear_tile", [](Map& map, const std::string& layer_name, uint32_t x, uint32_t row) {
+            return map.set_tile(layer_name, x, row, 0);
+        });
+}
+
 void Map::render_layer(Renderer* renderer, const Layer& layer)
 {
-    for (auto& l : layer.renderable) {
-        if (l.sprite) {
-            l.sprite->render(renderer);
+    const auto& clips = renderer->camera.clips;
+    for (uint32_t chunk = 0; chunk < layer.chunks.size(); ++chunk) {
+        const auto& info = layer.chunks[chunk];
+        if (info.count == 0 || !info.resident || !is_visible(info.bounds, clips, renderer->window_size.h)) {
             continue;
         }
 
-        Tile* tile = l.tile;
-        auto texture = tile->texture;
-        renderer->add_texture(texture, tile->src, l.dst, l.rotation_deg, l.flip_x, l.flip_y, false, layer.is_foreground);
+        const auto x0 = (chunk % layer.chunks_wide) * TileChunkSize;
+        const auto row0 = (chunk / layer.chunks_wide) * TileChunkSize;
+        const auto x1 = std::min(x0 + TileChunkSize, layer.width);
+        const auto row1 = std::min(row0 + TileChunkSize, layer.height);
+
+        for (auto y = row0; y < row1; ++y) {
+            const TileCell* row = &layer.cells[static_cast<size_t>(y) * layer.width];
+            for (auto x = x0; x < x1; ++x) {
+                const auto& cell = row[x];
+                if (cell.gid == 0) {
+                    continue;
+                }
+
+                if (cell.special) {
+                    const auto& l = layer.special[cell.special - 1];
+                    l.sprite->render(renderer);
+                    continue;
+                }
+
+                const auto& tile = tilemap[cell.gid];
+                if (!tile.texture) {
+                    continue;
+                }
+
+                SDL_Rect dst;
+                dst.x = (layer.x + x) * tile_width;
+                dst.y = (layer.height - y - layer.y - 1) * tile_height;
+                dst.w = tile.src.w;
+                dst.h = tile.src.h;
+                renderer->add_texture(tile.texture, tile.src, dst, (cell.bits & TileCell::Rotated) ? 90.0f : 0.0f,
+                    (cell.bits & TileCell::FlipX) != 0, (cell.bits & TileCell::FlipY) != 0, false, layer.is_foreground);
+            }
+        }
     }
 }
 
-LayerTile* Map::intersects(const Entity* other, const std::string& tile_type)
+TileRef Map::intersects(const Entity* other, TileFlag flag)
 {
     if (!other->collidable) {
-        return nullptr;
+        return TileRef();
     }
 
-    auto other_box = other->bbox();
+    return this->intersects(other, other->bbox(), flag);
+}
+
+TileRef Map::intersects(const Rect& bbox, TileFlag flag)
+{
+    return this->intersect_slow(bbox, flag);
+}
+
+TileRef Map::intersects(const Entity* other, const Rect& bbox, TileFlag flag)
+{
+    if (!other->collidable) {
+        return TileRef();
+    }
 
     if (other->do_pixel_collision_test) {
-        auto result = this->intersect_slow(other, other_box, tile_type);
-        if (result) {
-            return result;
-        }
-        return nullptr;
+        return this->intersect_slow(other, bbox, flag);
     }
 
-    auto result = this->intersects(other_box, tile_type);
-    if (result) {
-        return result;
+    return this->intersects(bbox, flag);
+}
+
+TileRef Map::intersects(const Entity* other, const std::string& tile_type)
+{
+    if (!other->collidable) {
+        return TileRef();
     }
 
-    return nullptr;
+    return this->intersects(other, other->bbox(), tile_type);
 }
 
-LayerTile* Map::intersects(const Rect& bbox, const std::string& tile_type)
+TileRef Map::intersects(const Rect& bbox, const std::string& tile_type)
 {
-    return this->intersect_slow(bbox, tile_type);
+    const auto flag = tile_flag_from_type(tile_type);
+    return this->intersect_slow(bbox, flag, flag == TileFlag::Other ? &tile_type : nullptr);
 }
 
-LayerTile* Map::intersects(const Entity* other, const Rect& bbox, const std::string& tile_type)
+TileRef Map::intersects(const Entity* other, const Rect& bbox, const std::string& tile_type)
 {
     if (!other->collidable) {
-        return nullptr;
+        return TileRef();
     }
 
+    const auto flag = tile_flag_from_type(tile_type);
+    const auto exact = flag == TileFlag::Other ? &tile_type : nullptr;
     if (other->do_pixel_collision_test) {
-        return this->intersect_slow(other, bbox, tile_type);
+        return this->intersect_slow(other, bbox, flag, exact);
     }
 
-    return this->intersects(bbox, tile_type);
+    return this->intersect_slow(bbox, flag, exact);
 }
 
-bool Map::intersect_precise(const LayerTile* layer_tile,
+bool Map::intersect_precise(const TileRef& tile,
     int32_t tx, int32_t ty,
     const Entity* other, const Rect& bbox,
     bool use_entity_collision_frame)
 {
-    auto& tile = layer_tile->tile;
-    std::shared_ptr<SDL_Surface> this_surface = nullptr;
-
-    SDL_Rect this_offset = { 0, 0, 0, 0 };
-    if (layer_tile->sprite) {
-        this_surface = layer_tile->sprite->surface;
-        const auto& this_frame = layer_tile->sprite->current_collision->current_frame();
-        this_offset.x = this_frame.x;
-        this_offset.y = this_frame.y;
-        this_offset.w = this_frame.w;
-        this_offset.h = this_frame.h;
-    } else {
-        this_surface = tile->surface;
-        this_offset.x = 0;
-        this_offset.y = 0;
-        this_offset.w = this_surface->w;
-        this_offset.h = this_surface->h;
+    const auto& sprite = tile.placed ? tile.placed->sprite : nullptr;
+    if (!sprite && !tile.tile) {
+        return false;
     }
 
-    uint8_t* this_pixels = reinterpret_cast<uint8_t*>(this_surface->pixels);
-    const int32_t this_bpp = this_surface->format->BytesPerPixel;
+    const auto& tile_masks = sprite
+        ? sprite->current_collision->current_frame().masks
+        : tile.tile->masks;
 
     auto& other_sprite = other->sprite;
-    const auto& other_surface = other_sprite->surface;
-    const uint8_t* other_pixels = reinterpret_cast<uint8_t*>(other_surface->pixels);
-    const int32_t other_bpp = other_surface->format->BytesPerPixel;
-
-    const auto other_pos = bbox;
-    AnimationFrame* other_frame = nullptr;
+    const AnimationFrame* other_frame = nullptr;
     if (use_entity_collision_frame) {
         other_frame = other->collision_frame();
     } else {
         other_frame = &other_sprite->current_animation->current_frame();
     }
 
-    SDL_Rect other_offset = {
-        other_frame->x,
-        other_frame->y,
-        other_frame->w,
-        other_frame->h
-    };
-
-    // Bounding box of tile relative to the layer
-    double ax0 = tx;
-    double ax1 = tx + this_offset.w - 1;
-    double ay0 = ty;
-    double ay1 = ty + this_offset.h - 1;
-
-    // Bounding box of entity relative to the layer
-    double bx0 = other_pos.x;
-    double bx1 = other_pos.x + other_offset.w - 1;
-    double by0 = other_pos.y;
-    double by1 = other_pos.y + other_offset.h - 1;
-
-    // Overlap of the two relative to the layer
-    auto cx0 = std::max(ax0, bx0);
-    auto cx1 = std::min(ax1, bx1);
-    auto cy0 = std::max(ay0, by0);
-    auto cy1 = std::min(ay1, by1);
-
-    // This shouldn't happen
-    if (cx1 < cx0 || cy1 < cy0) {
-        return nullptr;
+    // A streamed tile whose image is not loaded yet is solid wherever its box is
+    if (!tile_masks && !sprite && tile.tile->streamed) {
+        return !(tx >= bbox.x + bbox.w || bbox.x >= tx + tile.tile->src.w || ty >= bbox.y + bbox.h || bbox.y >= ty + tile.tile->src.h);
     }
 
-    // Pixel range for tile
-    auto tx0 = static_cast<int32_t>(cx0 - ax0);
-    auto ty0 = static_cast<int32_t>(cy0 - ay0);
-
-    // Other pixel offsets
-    auto ox0 = static_cast<int32_t>(cx0 - bx0);
-    auto oy0 = static_cast<int32_t>(cy0 - by0);
-
-    auto th = static_cast<int32_t>(this_offset.h - 1);
-    auto tw = static_cast<int32_t>(this_offset.w - 1);
-    auto oh = static_cast<int32_t>(other_offset.h - 1);
-    auto ow = static_cast<int32_t>(other_offset.w - 1);
-
-    auto w = static_cast<int32_t>(cx1 - cx0);
-    auto h = static_cast<int32_t>(cy1 - cy0);
-
-    for (int32_t y = 0; y < h; ++y) {
-        int32_t tile_y_px = this_offset.y + th - (ty0 + y);
-        if (layer_tile->flip_y) {
-            tile_y_px = this_offset.y + ty0 + y;
-        }
-
-        int32_t sprite_y_px = other_offset.y + oh - (oy0 + y);
-        if (other_sprite->flip_y) {
-            sprite_y_px = other_offset.y + oy0 + y;
-        }
-
-        for (int32_t x = 0; x < w; ++x) {
-            int32_t tile_x_px = this_offset.x + tx0 + x;
-            if (layer_tile->flip_x) {
-                tile_x_px = this_offset.x + tw - (tx0 + x);
-            }
-
-            int32_t sprite_x_px = other_offset.x + ox0 + x;
-            if (other_sprite->flip_x) {
-                sprite_x_px = other_offset.x + ow - (ox0 + x);
-            }
+    if (!tile_masks || !other_frame || !other_frame->masks) {
+        return false;
+    }
 
-            int32_t this_idx = tile_y_px * this_surface->pitch + tile_x_px * this_bpp;
-            int32_t other_idx = sprite_y_px * other_surface->pitch + sprite_x_px * other_bpp;
-            uint8_t* this_px = this_pixels + this_idx;
-            const uint8_t* other_px = other_pixels + other_idx;
-            if (*this_px > 0 && *other_px > 0) {
-                return true;
-            }
-        }
+    // Both masks were packed in each orientation at load time, so flips are just a lookup
+    const auto& this_mask = tile_masks->get(tile.flip_x, tile.flip_y);
+    if (this_mask.empty()) {
+        return false;
     }
 
-    return false;
+    const auto& other_mask = other_frame->masks->get(other_sprite->flip_x, other_sprite->flip_y);
+    return this_mask.overlaps(other_mask,
+        static_cast<int32_t>(bbox.x - tx),
+        static_cast<int32_t>(bbox.y - ty));
 }
 
 void Map::activate_dialog(Entity* activator, LayerTile* tile)
@@ -651,7 +1467,7 @@ void Map::activate_dialog(Entity* activator, LayerTile* tile)
     if (!activator->is_player()) {
         return;
     }
-    auto character = dynamic_cast<Character*>(activator);
+    auto character = static_cast<Character*>(activator);
     active_dialog = tile->dialog;
     active_dialog->start();
     active_dialog->attach_controller(character->controller);
@@ -666,74 +1482,36 @@ void Map::activate_tile(std::shared_ptr<Game>& game, Entity* activator, LayerTil
     }
 }
 
-LayerTile* Map::intersect_slow(const Entity* other, const Rect& bbox, const std::string& type)
+TileRef Map::intersect_slow(const Entity* other, const Rect& bbox, TileFlag flag, const std::string* tile_type)
 {
-    bool use_collision = (type != "Death");
-
-    // Is there a tile in this map that would occupy X/Y
-    for (auto& layer : layers) {
-        const int32_t x_off = layer.x * tile_width;
-        const int32_t y_off = layer.y * tile_height;
-        int32_t left = (bbox.x - x_off + 1) / tile_width;
-        int32_t right = ((bbox.x + bbox.w + 1) - x_off) / tile_width;
-        int32_t bottom = (bbox.y - y_off + 1) / tile_height;
-        int32_t top = ((bbox.y + bbox.h + 1) - y_off) / tile_height;
-
-        Rect bbox_rel;
-        bbox_rel.x = (bbox.x - x_off);
-        bbox_rel.y = (bbox.y - y_off);
-        bbox_rel.w = bbox.w;
-        bbox_rel.h = bbox.h;
-
-        if (right < 0 || left >= layer.width || top < 0 || bottom >= layer.height) {
-            return nullptr;
-        }
-
-        left = std::max(0, left);
-        right = std::min(static_cast<int32_t>(layer.width) - 1, right);
-        top = std::min(static_cast<int32_t>(layer.height) - 1, top);
-        bottom = std::max(0, bottom);
-
-        for (int32_t y = bottom; y <= top; ++y) {
-            for (int32_t x = left; x <= right; ++x) {
-                uint32_t idx = ((layer.height - y - 1) * layer.width + x);
-
-                // There is no tile here
-                if (layer.tile_table[idx] == 0) {
-                    continue;
-                }
-
-                int32_t tx = x * tile_width;
-                int32_t ty = y * tile_height;
+    // Death tiles are tested against what is drawn rather than the collision frame
+    const bool use_collision = flag != TileFlag::Death;
 
-                // Check properties of tile type, instead of checking collision type
-                auto layer_tile = &layer.layer_tile_lut[idx];
-                if (layer_tile->tile->type == type) {
-                    if (this->intersect_precise(layer_tile, tx, ty, other, bbox_rel, use_collision)) {
-                        return layer_tile;
-                    }
-                }
-            }
-        }
-    }
-
-    for (size_t i = 0; i < objects.size(); ++i) {
-        auto& obj = objects[i];
-        int32_t tx = obj.dst.x;
-        int32_t ty = obj.dst.y;
-        if (obj.type == type) {
-            if (this->intersect_precise(&obj, tx, ty, other, bbox, use_collision)) {
-                return &objects[i];
-            }
+    TileRef hit;
+    this->for_each_tile(bbox, flag, tile_type, [&](const TileRef& tile, const Rect& box) {
+        if (!this->intersect_precise(tile, static_cast<int32_t>(box.x), static_cast<int32_t>(box.y), other, bbox, use_collision)) {
+            return true;
         }
-    }
+        hit = tile;
+        return false;
+    });
 
-    return nullptr;
+    return hit;
 }
 
-LayerTile* Map::intersect_slow(const Rect& other_box, const std::string& tile_type)
+TileRef Map::intersect_slow(const Rect& other_box, TileFlag flag, const std::string* tile_type)
 {
-    return nullptr;
+    TileRef hit;
+    this->for_each_tile(other_box, flag, tile_type, [&](const TileRef& tile, const Rect& box) {
+        // Boxes that only share an edge do not intersect
+        if (box.x >= other_box.x + other_box.w || other_box.x >= box.x + box.w || box.y >= other_box.y + other_box.h || other_box.y >= box.y + box.h) {
+            return true;
+        }
+        hit = tile;
+        return false;
+    });
+
+    return hit;
 }
 
 void Map::render(Renderer* renderer)
@@ -746,6 +1524,9 @@ void Map::render(Renderer* renderer)
             tile.texture.reset(
                 renderer->create_texture(tile.surface),
                 SDLDeleter());
+            if (tile.texture) {
+                renderer->release_surface(tile.surface);
+            }
         }
 
         for (auto& parallax : parallax_bg) {
@@ -759,8 +1540,15 @@ void Map::render(Renderer* renderer)
         tilemap_texture_allocated = true;
     }
 
-    for (const auto& layer : layers) {
-        this->render_layer(renderer, layer);
+    if (streamer) {
+        streamer->upload(renderer);
+    }
+
+    {
+        std::scoped_lock<std::mutex> lck(mutex);
+        for (const auto& layer : layers) {
+            this->render_layer(renderer, layer);
+        }
     }
 
     for (const auto& obj : objects) {
@@ -774,6 +1562,9 @@ void Map::render(Renderer* renderer)
 
 void Map::think(std::shared_ptr<Game>& game)
 {
+    if (streamer) {
+        streamer->update(game->focus_bounds());
+    }
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,226 @@
+#include <SDL_image.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <raptr/common/logging.hpp>
+#include <raptr/config.hpp>
+#include <raptr/game/map.hpp>
+#include <raptr/game/map_streamer.hpp>
+#include <raptr/renderer/renderer.hpp>
+
+namespace {
+auto logger = raptr::_get_logger(__FILE__);
+};
+
+namespace raptr {
+
+MapStreamer::MapStreamer(Map& map_, const Config& config)
+    : map(map_)
+    , load_radius(config.stream_radius_px)
+    , evict_radius(config.stream_radius_px + std::max(config.stream_hysteresis_px, 0.0))
+    , uploads_per_frame(std::max(config.stream_uploads_per_frame, 1))
+    , users(map_.tilemap.size(), 0)
+    , state(map_.tilemap.size(), TileState::Unloaded)
+{
+    worker = std::thread([this]() { this->worker_loop(); });
+}
+
+MapStreamer::~MapStreamer()
+{
+    {
+        std::scoped_lock<std::mutex> lck(load_mutex);
+        stopping = true;
+    }
+    load_wake.notify_all();
+    worker.join();
+}
+
+void MapStreamer::worker_loop()
+{
+    while (true) {
+        std::pair<uint32_t, std::string> request;
+        {
+            std::unique_lock<std::mutex> lck(load_mutex);
+            load_wake.wait(lck, [this]() { return stopping || !requests.empty(); });
+            if (stopping) {
+                return;
+            }
+            request = std::move(requests.front());
+            requests.pop_front();
+        }
+
+        Decoded result;
+        result.gid = request.first;
+        SDL_Surface* surface = IMG_Load(request.second.c_str());
+        if (surface) {
+            result.surface.reset(surface, SDLDeleter());
+            result.masks = CollisionMasks::from_pixels(reinterpret_cast<const uint8_t*>(surface->pixels),
+                surface->pitch, surface->format->BytesPerPixel, surface->w, surface->h);
+        } else {
+            logger->error("Could not stream {}: {}", request.second, IMG_GetError());
+        }
+
+        std::scoped_lock<std::mutex> lck(load_mutex);
+        decoded.push_back(std::move(result));
+    }
+}
+
+void MapStreamer::update(const std::vector<Bounds>& foci)
+{
+    this->apply_decoded();
+
+    if (foci.empty()) {
+        return;
+    }
+
+    // The render thread reads which chunks are resident while drawing
+    std::scoped_lock<std::mutex> lck(map.mutex);
+    for (auto& layer : map.layers) {
+        for (uint32_t chunk = 0; chunk < layer.chunks.size(); ++chunk) {
+            const auto& info = layer.chunks[chunk];
+            if (info.count == 0 && !info.resident) {
+                continue;
+            }
+
+            const auto& b = info.bounds;
+            auto nearest = std::numeric_limits<double>::max();
+            for (const auto& c : foci) {
+                const auto dx = std::max({ 0.0, c.min[0] - (b.x + b.w), b.x - c.max[0] });
+                const auto dy = std::max({ 0.0, c.min[1] - (b.y + b.h), b.y - c.max[1] });
+                nearest = std::min(nearest, std::sqrt(dx * dx + dy * dy));
+            }
+
+            if (!info.resident && nearest <= load_radius) {
+                this->load_chunk(layer, chunk);
+            } else if (info.resident && nearest > evict_radius) {
+                this->evict_chunk(layer, chunk);
+            }
+        }
+    }
+}
+
+void MapStreamer::upload(Renderer* renderer)
+{
+    std::vector<Upload> batch;
+    {
+        std::scoped_lock<std::mutex> lck(upload_mutex);
+        int32_t created = 0;
+        while (!uploads.empty() && created < uploads_per_frame) {
+            if (uploads.front().surface) {
+                ++created;
+            }
+            batch.push_back(std::move(uploads.front()));
+            uploads.pop_front();
+        }
+    }
+
+    // The surface is dropped once its texture exists; it is decoded again if the tile comes back
+    for (auto& upload : batch) {
+        auto& tile = map.tilemap[upload.gid];
+        if (upload.surface) {
+            tile.texture.reset(renderer->create_texture(upload.surface), SDLDeleter());
+        } else {
+            tile.texture.reset();
+        }
+    }
+}
+
+void MapStreamer::retain(uint32_t gid)
+{
+    if (!map.tilemap[gid].streamed || users[gid]++ > 0 || state[gid] != TileState::Unloaded) {
+        return;
+    }
+
+    state[gid] = TileState::Loading;
+    {
+        std::scoped_lock<std::mutex> lck(load_mutex);
+        requests.emplace_back(gid, map.tilemap[gid].image);
+    }
+    load_wake.notify_one();
+}
+
+void MapStreamer::release(uint32_t gid)
+{
+    if (!map.tilemap[gid].streamed || users[gid] == 0 || --users[gid] > 0) {
+        return;
+    }
+
+    // A tile still loading is dropped when it arrives instead
+    if (state[gid] != TileState::Loaded) {
+        return;
+    }
+
+    state[gid] = TileState::Unloaded;
+    map.tilemap[gid].masks.reset();
+    --loaded_count;
+
+    std::scoped_lock<std::mutex> lck(upload_mutex);
+    uploads.push_back({ gid, nullptr });
+}
+
+void MapStreamer::apply_decoded()
+{
+    std::vector<Decoded> done;
+    {
+        std::scoped_lock<std::mutex> lck(load_mutex);
+        done.swap(decoded);
+    }
+
+    for (auto& d : done) {
+        if (users[d.gid] == 0) {
+            state[d.gid] = TileState::Unloaded;
+            continue;
+        }
+
+        // Nothing queries the map between ticks, so the masks can be swapped in here
+        state[d.gid] = TileState::Loaded;
+        map.tilemap[d.gid].masks = std::move(d.masks);
+        ++loaded_count;
+
+        if (d.surface) {
+            std::scoped_lock<std::mutex> lck(upload_mutex);
+            uploads.push_back({ d.gid, std::move(d.surface) });
+        }
+    }
+}
+
+void MapStreamer::load_chunk(Layer& layer, uint32_t chunk)
+{
+    layer.chunks[chunk].resident = true;
+    ++resident_count;
+
+    const auto x0 = (chunk % layer.chunks_wide) * TileChunkSize;
+    const auto row0 = (chunk / layer.chunks_wide) * TileChunkSize;
+    const auto x1 = std::min(x0 + TileChunkSize, layer.width);
+    const auto row1 = std::min(row0 + TileChunkSize, layer.height);
+    for (auto row = row0; row < row1; ++row) {
+        for (auto x = x0; x < x1; ++x) {
+            const auto gid = layer.cells[static_cast<size_t>(row) * layer.width + x].gid;
+            if (gid != 0) {
+                this->retain(gid);
+            }
+        }
+    }
+}
+
+void MapStreamer::evict_chunk(Layer& layer, uint32_t chunk)
+{
+    layer.chunks[chunk].resident = false;
+    --resident_count;
+
+    const auto x0 = (chunk % layer.chunks_wide) * TileChunkSize;
+    const auto row0 = (chunk / layer.chunks_wide) * TileChunkSize;
+    const auto x1 = std::min(x0 + TileChunkSize, layer.width);
+    const auto row1 = std::min(row0 + TileChunkSize, layer.height);
+    for (auto row = row0; row < row1; ++row) {
+        for (auto x = x0; x < x1; ++x) {
+            const auto gid = layer.cells[static_cast<size_t>(row) * layer.width + x].gid;
+            if (gid != 0) {
+                this->release(gid);
+            }
+        }
+    }
+}
+
+} // namespace raptr
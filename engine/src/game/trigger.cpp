@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include <raptr/common/logging.hpp>
 #include <raptr/game/character.hpp>
 #include <raptr/game/game.hpp>
@@ -13,14 +15,14 @@ namespace raptr {
 Trigger::Trigger()
     : Entity()
 {
+    kind = EntityKind::Trigger;
     shape.h = 0;
     shape.w = 0;
     shape.x = 0;
     shape.y = 0;
     do_pixel_collision_test = false;
-    pos_.x = shape.x;
-    pos_.y = shape.y;
-    think_rate_us = 100;
+    position_rel() = { shape.x, shape.y };
+    think_rate_us = 100 * 1000;
     collidable = false;
 }
 
@@ -28,59 +30,41 @@ std::shared_ptr<Trigger> Trigger::from_params(Rect shape)
 {
     auto trigger = std::make_shared<Trigger>();
     trigger->shape = shape;
-    trigger->pos_.x = shape.x;
-    trigger->pos_.y = shape.y;
+    trigger->position_rel() = { shape.x, shape.y };
     return trigger;
 }
 
 void Trigger::think(std::shared_ptr<Game>& game)
 {
-    auto current_think_time_us = clock::ticks();
-    if (current_think_time_us - last_think_time_us < think_rate_us) {
-        return;
-    }
-    last_think_time_us = current_think_time_us;
-
     if (!on_enter) {
         return;
     }
 
     auto intersected_characters = game->intersect_characters(this, shape);
-    if (intersected_characters.empty()) {
-        if (on_exit) {
-            for (auto& pair : tracking) {
-                on_exit(pair.second, this);
-            }
-        }
-        tracking.clear();
-        return;
-    }
-
-    std::map<std::array<unsigned char, 16>, std::shared_ptr<Character>> temp_tracking;
 
+    std::vector<EntityHandle> now_tracking;
     for (auto& character : intersected_characters) {
-        bool newly_seen = true;
-        const auto guid = character->guid();
-        if (tracking.find(guid) != tracking.end()) {
-            newly_seen = false;
-        }
-
-        temp_tracking[guid] = character;
-
-        if (newly_seen) {
+        now_tracking.push_back(character->handle);
+        if (std::find(tracking.begin(), tracking.end(), character->handle) == tracking.end()) {
             on_enter(character, this);
         }
     }
 
     if (on_exit) {
-        for (auto& pair : tracking) {
-            if (temp_tracking.find(pair.first) == temp_tracking.end()) {
-                on_exit(pair.second, this);
+        for (auto& handle : tracking) {
+            if (std::find(now_tracking.begin(), now_tracking.end(), handle) != now_tracking.end()) {
+                continue;
+            }
+
+            // A character that has since been removed can not be told it left
+            auto character = game->resolve<Character>(handle);
+            if (character) {
+                on_exit(character, this);
             }
         }
     }
 
-    tracking = temp_tracking;
+    tracking = std::move(now_tracking);
 }
 
 Rect Trigger::bbox() const
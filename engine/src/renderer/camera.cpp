@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include <raptr/game/entity.hpp>
 #include <raptr/renderer/camera.hpp>
 #include <raptr/renderer/renderer.hpp>
@@ -43,10 +45,22 @@ void Camera::think(Renderer* renderer, uint64_t delta_us)
 
     clips.clear();
 
+    // Anything that was removed from the game since the last frame is no longer followed
+    std::vector<std::shared_ptr<Entity>> followed;
+    tracking.erase(std::remove_if(tracking.begin(), tracking.end(), [&](const EntityHandle& handle) {
+        const auto entity = entities ? entities->get(handle) : nullptr;
+        if (!entity) {
+            return true;
+        }
+        followed.push_back(*entity);
+        return false;
+    }),
+        tracking.end());
+
     Bounds new_bounds = b;
     float speed_x = 1.0;
     float speed_y = 1.0;
-    if (tracking.empty()) {
+    if (followed.empty()) {
         new_bounds = b;
     } else {
         trap_state = { false, false, false, false };
@@ -55,7 +69,7 @@ void Camera::think(Renderer* renderer, uint64_t delta_us)
         int32_t hh = renderer->window_size.h / 2;
         Point avg = { 0, 0 };
         bool wait = false;
-        for (auto& entity : tracking) {
+        for (auto& entity : followed) {
             auto b = entity->bbox();
             auto p = entity->position_abs();
             auto& v = entity->velocity_rel();
@@ -87,7 +101,7 @@ void Camera::think(Renderer* renderer, uint64_t delta_us)
             }
         }
 
-        float n = tracking.size();
+        float n = followed.size();
         Point d = { avg.x / n, avg.y / n };
 
         if (wait) {
@@ -207,7 +221,7 @@ void Camera::render(Renderer* renderer, const CameraClip& c)
     renderer->add_rect(center_rect, red, false, false);
 }
 
-void Camera::track(std::shared_ptr<Entity> entity)
+void Camera::track(EntityHandle entity)
 {
     tracking.push_back(entity);
 }
@@ -96,6 +96,9 @@ void Parallax::render(Renderer* renderer, const SDL_Rect& clip, int32_t rx)
     for (auto& layer : layers) {
         if (!layer.texture) {
             layer.texture.reset(renderer->create_texture(layer.surface), ::SDLDeleter());
+            if (layer.texture) {
+                renderer->release_surface(layer.surface);
+            }
         }
 
         int32_t cx = clip.x;
@@ -104,7 +107,7 @@ void Parallax::render(Renderer* renderer, const SDL_Rect& clip, int32_t rx)
         if (is_foreground) {
             // Things that are closer move faster
             transformed_dst.x -= static_cast<int32_t>(cx * (1.0 + layer.z_index / 100.0));
-            transformed_dst.y = static_cast<int32_t>(renderer->logical_size.h - layer.surface->h);
+            transformed_dst.y = static_cast<int32_t>(renderer->logical_size.h - layer.bbox.h);
         } else {
             transformed_dst.x -= static_cast<int32_t>(cx * (1.0 - layer.z_index / 100.0)) + rx;
             transformed_dst.y = 0; // static_cast<int32_t>(renderer->logical_size.h - (layer.surface->h + clip.y * (layer.z_index / 100.0)));
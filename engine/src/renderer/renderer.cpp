@@ -80,6 +80,7 @@ bool Renderer::init(std::shared_ptr<Config>& config)
 
     fps = 144;
     show_fps = true;
+    sim_alpha = 0;
     last_render_time_us = clock::ticks();
 
     if (is_headless) {
@@ -227,6 +228,12 @@ void Renderer::run_frame(bool force_render)
                << std::ceil(texture_mem_pool.off / 1024.0 / 1024.0) << "MB) mempool full";
             mempool_text = this->add_text({ 5, 40 }, ss.str(), 20);
 
+            if (config && !config->keep_surfaces) {
+                ss = std::stringstream();
+                ss << std::round(surface_bytes_released / 1024.0 / 1024.0 * 10.0) / 10.0 << "MB of surfaces released";
+                surfaces_text = this->add_text({ 5, 60 }, ss.str(), 20);
+            }
+
             frame_counter_time_start = clock::ticks();
             frame_fps = static_cast<float>(frame_counter / secs);
             frame_counter = 1;
@@ -243,6 +250,10 @@ void Renderer::run_frame(bool force_render)
         if (mempool_text) {
             mempool_text->render(this, { 5, 40 });
         }
+
+        if (surfaces_text) {
+            surfaces_text->render(this, { 5, 60 });
+        }
     }
 
     texture_mem_pool.ptr = texture_mem_pool.mem;
@@ -269,13 +280,16 @@ bool Renderer::toggle_fullscreen()
 void Renderer::camera_follow(std::vector<std::shared_ptr<Entity>> entities)
 {
     std::scoped_lock<std::mutex> lck(mutex);
-    camera.tracking = entities;
+    camera.tracking.clear();
+    for (auto& entity : entities) {
+        camera.tracking.push_back(entity->handle);
+    }
 }
 
 void Renderer::camera_follow(std::shared_ptr<Entity> entity)
 {
     std::scoped_lock<std::mutex> lck(mutex);
-    camera.tracking.push_back(entity);
+    camera.track(entity->handle);
 }
 
 SDL_Texture* Renderer::create_texture(std::shared_ptr<SDL_Surface>& surface)
@@ -287,6 +301,18 @@ SDL_Texture* Renderer::create_texture(std::shared_ptr<SDL_Surface>& surface)
     return SDL_CreateTextureFromSurface(sdl.renderer, surface.get());
 }
 
+void Renderer::release_surface(std::shared_ptr<SDL_Surface>& surface)
+{
+    if (!surface || is_headless || !config || config->keep_surfaces) {
+        return;
+    }
+
+    if (surface.use_count() == 1) {
+        surface_bytes_released += static_cast<uint64_t>(surface->pitch) * surface->h;
+    }
+    surface.reset();
+}
+
 void Renderer::add_texture(std::shared_ptr<SDL_Texture> texture,
     SDL_Rect src, SDL_Rect dst,
     float angle, bool flip_x, bool flip_y,
@@ -407,6 +433,7 @@ void Renderer::setup_lua_context(sol::state& state)
 {
     state.new_usertype<Renderer>("Renderer",
         "show_fps", &Renderer::show_fps,
+        "surface_bytes_released", sol::readonly(&Renderer::surface_bytes_released),
         "toggle_fullscreen", &Renderer::toggle_fullscreen);
 }
 
@@ -1,7 +1,9 @@
 #include <iostream>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <tuple>
 
 #include <SDL_image.h>
 #include <picojson.h>
@@ -18,9 +20,12 @@ auto logger = raptr::_get_logger(__FILE__);
 
 namespace raptr {
 std::map<fs::path, std::shared_ptr<SDL_Surface>> SURFACE_CACHE;
-std::map<std::shared_ptr<SDL_Surface>, std::shared_ptr<SDL_Texture>> TEXTURE_CACHE;
+std::map<fs::path, std::shared_ptr<SDL_Texture>> TEXTURE_CACHE;
 std::map<fs::path, std::shared_ptr<Sprite>> SPRITE_CACHE;
 
+//! Guards SURFACE_CACHE and SPRITE_CACHE, which sprites are loaded into on the game thread and released from on the render thread
+std::mutex CACHE_MUTEX;
+
 int32_t p_int(const picojson::value& v, const std::string& name)
 {
     return static_cast<int32_t>(v.get(name).get<double>());
@@ -51,6 +56,47 @@ bool Animation::next(int64_t clock, double speed_multiplier)
         }
     }
 
+    this->step();
+    return true;
+}
+
+int64_t Animation::advance(int64_t elapsed_us, double speed_multiplier)
+{
+    const auto rate = speed * speed_multiplier;
+    if (rate <= 0 || frames.empty()) {
+        return 0;
+    }
+
+    const auto frame_us = [&](int32_t i) {
+        return static_cast<int64_t>(frames[i].duration * 1e3 / rate);
+    };
+
+    // Whole loops end where they started, so only the remainder is stepped through
+    if (direction == AnimationDirection::forward && !hold_last_frame) {
+        int64_t loop_us = 0;
+        for (int32_t i = from; i <= to; ++i) {
+            loop_us += frame_us(i);
+        }
+        if (loop_us > 0) {
+            elapsed_us %= loop_us;
+        }
+    }
+
+    const auto max_steps = 2 * static_cast<int32_t>(frames.size());
+    for (int32_t steps = 0; steps < max_steps; ++steps) {
+        const auto duration = frame_us(frame);
+        if (elapsed_us <= duration) {
+            return elapsed_us;
+        }
+        elapsed_us -= duration;
+        this->step();
+    }
+
+    return 0;
+}
+
+void Animation::step()
+{
     switch (direction) {
     case AnimationDirection::forward:
         ++frame;
@@ -83,8 +129,6 @@ bool Animation::next(int64_t clock, double speed_multiplier)
         }
         break;
     }
-
-    return true;
 }
 
 bool Animation::register_sound_effect(int32_t frame, FileInfo wav, bool do_loop)
@@ -105,6 +149,7 @@ std::shared_ptr<Sprite> Sprite::from_json(const FileInfo& path, bool reload)
 {
 
     if (!reload) {
+        std::scoped_lock<std::mutex> lck(CACHE_MUTEX);
         auto in_cache = SPRITE_CACHE.find(path.file_relative);
         if (in_cache != SPRITE_CACHE.end()) {
             logger->info("Loading {} from cache", path.file_relative);
@@ -138,16 +183,25 @@ std::shared_ptr<Sprite> Sprite::from_json(const FileInfo& path, bool reload)
 
     logger->debug("Sprite texture is located at {}", image_path);
 
-    auto exists = SURFACE_CACHE.find(image_path);
-    if (exists != SURFACE_CACHE.end()) {
-        sprite->surface = exists->second;
-    } else {
+    sprite->sheet_path = image_path;
+
+    {
+        std::scoped_lock<std::mutex> lck(CACHE_MUTEX);
+        auto exists = SURFACE_CACHE.find(image_path);
+        if (exists != SURFACE_CACHE.end()) {
+            sprite->surface = exists->second;
+        }
+    }
+
+    if (!sprite->surface) {
         SDL_Surface* surface = IMG_Load(image_cpath.c_str());
         if (!surface) {
             logger->error("Sprite texture failed to load from {}: {}",
                 image_path);
             return nullptr;
         }
+
+        std::scoped_lock<std::mutex> lck(CACHE_MUTEX);
         SURFACE_CACHE[image_path].reset(surface, SDLDeleter());
         sprite->surface = SURFACE_CACHE[image_path];
     }
@@ -207,6 +261,22 @@ std::shared_ptr<Sprite> Sprite::from_json(const FileInfo& path, bool reload)
         sprite->animations[tag_name] = animation;
     }
 
+    // Collision masks are packed once per distinct frame, shared by every animation and clone using it
+    std::map<std::tuple<int32_t, int32_t, int32_t, int32_t>, std::shared_ptr<const CollisionMasks>> masks;
+    const auto& surface = sprite->surface;
+    const auto pixels = reinterpret_cast<const uint8_t*>(surface->pixels);
+    const int32_t bpp = surface->format->BytesPerPixel;
+    for (auto& anim : sprite->animations) {
+        for (auto& frame : anim.second.frames) {
+            auto& mask = masks[std::make_tuple(frame.x, frame.y, frame.w, frame.h)];
+            if (!mask) {
+                const auto origin = pixels + frame.y * surface->pitch + frame.x * bpp;
+                mask = CollisionMasks::from_pixels(origin, surface->pitch, bpp, frame.w, frame.h);
+            }
+            frame.masks = mask;
+        }
+    }
+
     Animation* default_collision = nullptr;
     for (auto& anim : sprite->animations) {
         const auto& tag_name = anim.first;
@@ -261,6 +331,7 @@ std::shared_ptr<Sprite> Sprite::from_json(const FileInfo& path, bool reload)
     sprite->render_in_foreground = false;
     sprite->set_animation("Idle");
 
+    std::scoped_lock<std::mutex> lck(CACHE_MUTEX);
     SPRITE_CACHE[path.file_relative] = sprite;
 
     return sprite->clone(false);
@@ -269,14 +340,33 @@ std::shared_ptr<Sprite> Sprite::from_json(const FileInfo& path, bool reload)
 void Sprite::render(Renderer* renderer)
 {
     if (!texture) {
-        const auto exists = TEXTURE_CACHE.find(surface);
+        const auto exists = TEXTURE_CACHE.find(sheet_path);
         if (exists == TEXTURE_CACHE.end()) {
-            TEXTURE_CACHE[surface].reset(renderer->create_texture(surface), SDLDeleter());
-            texture = TEXTURE_CACHE[surface];
+            TEXTURE_CACHE[sheet_path].reset(renderer->create_texture(surface), SDLDeleter());
+            texture = TEXTURE_CACHE[sheet_path];
         } else {
             texture = exists->second;
         }
         SDL_SetTextureBlendMode(texture.get(), blend_mode);
+
+        // The masks were packed at load, so once the sheet is uploaded nothing reads its pixels
+        if (texture) {
+            std::scoped_lock<std::mutex> lck(CACHE_MUTEX);
+            const auto cached_surface = SURFACE_CACHE.find(sheet_path);
+            if (cached_surface != SURFACE_CACHE.end()) {
+                renderer->release_surface(cached_surface->second);
+                if (!cached_surface->second) {
+                    SURFACE_CACHE.erase(cached_surface);
+                }
+            }
+
+            const auto cached_sprite = SPRITE_CACHE.find(path.file_relative);
+            if (cached_sprite != SPRITE_CACHE.end()) {
+                renderer->release_surface(cached_sprite->second->surface);
+            }
+
+            renderer->release_surface(surface);
+        }
     }
 
     if (current_collision->name != current_animation->name) {
@@ -310,6 +400,18 @@ void Sprite::render(Renderer* renderer)
     renderer->add_texture(texture, src, dst, rotation_deg, flip_x, flip_y, absolute_positioning, render_in_foreground);
 }
 
+void Sprite::catch_up()
+{
+    const auto now = clock::ticks();
+    const auto elapsed_us = now - last_frame_tick;
+
+    if (current_collision && current_collision->name != current_animation->name) {
+        current_collision->advance(elapsed_us, speed);
+    }
+
+    last_frame_tick = now - current_animation->advance(elapsed_us, speed);
+}
+
 bool Sprite::has_animation(const std::string& name)
 {
     return animations.find(name) != animations.end();
@@ -359,6 +461,7 @@ std::shared_ptr<Sprite> Sprite::clone(bool reload)
     sprite->height = height;
     sprite->speed = speed;
     sprite->surface = surface;
+    sprite->sheet_path = sheet_path;
     sprite->animations = animations;
     sprite->current_animation = nullptr;
 
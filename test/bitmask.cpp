@@ -0,0 +1,103 @@
+#include <catch.hpp>
+
+#include <random>
+#include <vector>
+
+#include <raptr/common/bitmask.hpp>
+
+namespace {
+struct Image {
+    int32_t w, h;
+    std::vector<uint8_t> pixels;
+};
+
+Image random_image(int32_t w, int32_t h, double fill, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::bernoulli_distribution solid(fill);
+    Image image { w, h, std::vector<uint8_t>(w * h) };
+    for (auto& p : image.pixels) {
+        p = solid(rng) ? 255 : 0;
+    }
+    return image;
+}
+
+raptr::Bitmask mask_of(const Image& image)
+{
+    return raptr::Bitmask::from_pixels(image.pixels.data(), image.w, 1, image.w, image.h);
+}
+
+bool brute_overlaps(const raptr::Bitmask& a, const raptr::Bitmask& b, int32_t dx, int32_t dy)
+{
+    for (int32_t y = 0; y < a.height(); ++y) {
+        for (int32_t x = 0; x < a.width(); ++x) {
+            if (a.test(x, y) && b.test(x - dx, y - dy)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+}
+
+TEST_CASE("Masks are built bottom row first, in every orientation", "[bitmask]")
+{
+    // Top-left and bottom-right pixels of a 3x2 image are solid
+    const uint8_t pixels[] = {
+        1, 0, 0,
+        0, 0, 1
+    };
+
+    const auto masks = raptr::CollisionMasks::from_pixels(pixels, 3, 1, 3, 2);
+    const auto& plain = masks->get(false, false);
+    REQUIRE(plain.test(2, 0));
+    REQUIRE(plain.test(0, 1));
+    REQUIRE_FALSE(plain.test(0, 0));
+
+    REQUIRE(masks->get(true, false).test(0, 0));
+    REQUIRE(masks->get(true, false).test(2, 1));
+    REQUIRE(masks->get(false, true).test(0, 0));
+    REQUIRE(masks->get(false, true).test(2, 1));
+    REQUIRE(masks->get(true, true).test(2, 0));
+    REQUIRE(masks->get(true, true).test(0, 1));
+
+    REQUIRE_FALSE(plain.empty());
+    REQUIRE_FALSE(plain.opaque());
+}
+
+TEST_CASE("Solid and blank masks are flagged", "[bitmask]")
+{
+    const std::vector<uint8_t> solid(70 * 3, 9);
+    const std::vector<uint8_t> blank(70 * 3, 0);
+
+    const auto full = raptr::Bitmask::from_pixels(solid.data(), 70, 1, 70, 3);
+    const auto none = raptr::Bitmask::from_pixels(blank.data(), 70, 1, 70, 3);
+    REQUIRE(full.opaque());
+    REQUIRE(none.empty());
+    REQUIRE(full.overlaps(full, 69, -2));
+    REQUIRE_FALSE(full.overlaps(full, 70, 0));
+    REQUIRE_FALSE(full.overlaps(none, 0, 0));
+}
+
+TEST_CASE("Overlaps agree with a pixel by pixel test at every offset", "[bitmask]")
+{
+    // Narrow masks take the packed row path, wide ones the word by word path
+    for (const auto& sizes : { std::make_pair(16, 24), std::make_pair(64, 40), std::make_pair(130, 75) }) {
+        const auto a = mask_of(random_image(sizes.first, 20, 0.05, 1));
+        const auto b = mask_of(random_image(sizes.second, 13, 0.05, 2));
+
+        for (int32_t dy = -b.height(); dy <= a.height(); ++dy) {
+            for (int32_t dx = -b.width(); dx <= a.width(); ++dx) {
+                if (a.overlaps(b, dx, dy) != brute_overlaps(a, b, dx, dy)) {
+                    FAIL("mismatch at " << dx << ", " << dy);
+                }
+                if (b.overlaps(a, -dx, -dy) != brute_overlaps(a, b, dx, dy)) {
+                    FAIL("mismatch at " << -dx << ", " << -dy << " swapped");
+                }
+            }
+        }
+
+        REQUIRE(a.any(0, 0, a.width(), a.height()));
+        REQUIRE_FALSE(a.any(a.width(), 0, a.width() + 5, a.height()));
+    }
+}
@@ -0,0 +1,346 @@
+#include <catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include <raptr/common/broadphase.hpp>
+
+namespace {
+struct Mover {
+    raptr::SlotHandle handle;
+    raptr::Bounds bounds;
+    double vx, vy;
+};
+
+std::vector<Mover> make_movers(size_t count, double world, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> position(0, world);
+    std::uniform_real_distribution<double> size(8, 48);
+    std::uniform_real_distribution<double> speed(-4, 4);
+
+    std::vector<Mover> movers(count);
+    for (size_t i = 0; i < count; ++i) {
+        const auto x = position(rng);
+        const auto y = position(rng);
+        movers[i].handle = raptr::SlotHandle::make(static_cast<uint32_t>(i), 1);
+        movers[i].bounds = raptr::Bounds(x, x + size(rng), y, y + size(rng));
+        movers[i].vx = speed(rng);
+        movers[i].vy = speed(rng);
+    }
+    return movers;
+}
+
+raptr::Bounds moved(const raptr::Bounds& b, double dx, double dy)
+{
+    return raptr::Bounds(b.min[0] + dx, b.max[0] + dx, b.min[1] + dy, b.max[1] + dy);
+}
+
+std::vector<uint32_t> query_all(raptr::Broadphase& broadphase, const raptr::Bounds& box)
+{
+    std::vector<uint32_t> found;
+    broadphase.query(
+        box, [](raptr::SlotHandle handle, void* context) -> bool {
+            reinterpret_cast<std::vector<uint32_t>*>(context)->push_back(handle.value);
+            return true;
+        },
+        &found);
+    std::sort(found.begin(), found.end());
+    return found;
+}
+}
+
+TEST_CASE("Every broadphase finds exactly what overlaps, after moves", "[broadphase]")
+{
+    auto movers = make_movers(500, 2000, 7);
+    for (const auto kind : { "rtree", "hash" }) {
+        auto broadphase = raptr::Broadphase::create(kind, 64);
+        REQUIRE(broadphase);
+
+        auto current = movers;
+        for (const auto& m : current) {
+            broadphase->insert(m.handle, m.bounds);
+        }
+
+        for (int32_t step = 0; step < 20; ++step) {
+            for (auto& m : current) {
+                const auto to = moved(m.bounds, m.vx * 10, m.vy * 10);
+                broadphase->move(m.handle, m.bounds, to);
+                m.bounds = to;
+            }
+        }
+
+        REQUIRE(broadphase->size() == current.size());
+
+        const raptr::Bounds box(500, 900, 300, 1400);
+        std::vector<uint32_t> expected;
+        for (const auto& m : current) {
+            const auto& b = m.bounds;
+            if (!(b.min[0] > box.max[0] || box.min[0] > b.max[0] || b.min[1] > box.max[1] || box.min[1] > b.max[1])) {
+                expected.push_back(m.handle.value);
+            }
+        }
+        std::sort(expected.begin(), expected.end());
+
+        REQUIRE(query_all(*broadphase, box) == expected);
+
+        for (const auto& m : current) {
+            broadphase->remove(m.handle, m.bounds);
+        }
+        REQUIRE(broadphase->size() == 0);
+        REQUIRE(query_all(*broadphase, box).empty());
+    }
+}
+
+TEST_CASE("An R-tree with an odd fanout stays correct through removals and a reset", "[broadphase]")
+{
+    // Five branches per node leaves a tail that the paired overlap test does not cover
+    RTree<raptr::SlotHandle, double, 2, double, 5> tree;
+    const auto movers = make_movers(300, 1000, 11);
+    const raptr::Bounds box(200, 600, 100, 700);
+
+    const auto count_in_box = [&]() {
+        return tree.Search(box.min, box.max, [](raptr::SlotHandle, void*) -> bool { return true; }, nullptr);
+    };
+
+    for (int32_t pass = 0; pass < 2; ++pass) {
+        for (const auto& m : movers) {
+            tree.Insert(m.bounds.min, m.bounds.max, m.handle);
+        }
+
+        int expected = 0;
+        for (size_t i = 0; i < movers.size(); ++i) {
+            if (i % 3 == 0) {
+                tree.Remove(movers[i].bounds.min, movers[i].bounds.max, movers[i].handle);
+            } else if (raptr::bounds_overlap(movers[i].bounds, box)) {
+                ++expected;
+            }
+        }
+
+        REQUIRE(tree.Count() == 200);
+        REQUIRE(count_in_box() == expected);
+        tree.RemoveAll();
+        REQUIRE(count_in_box() == 0);
+    }
+}
+
+TEST_CASE("A bulk loaded R-tree finds what an incrementally built one does", "[broadphase]")
+{
+    const auto movers = make_movers(1000, 3000, 5);
+
+    raptr::RTreeBroadphase incremental;
+    raptr::RTreeBroadphase packed;
+    std::vector<raptr::BroadphaseEntry> batch;
+    for (const auto& m : movers) {
+        incremental.insert(m.handle, m.bounds);
+        batch.push_back({ m.handle, m.bounds, raptr::BroadphaseTag() });
+    }
+
+    // Half loaded as a batch into an empty tree, then the rest repacked on top of it
+    const auto half = batch.size() / 2;
+    packed.insert_batch({ batch.begin(), batch.begin() + half });
+    packed.insert_batch({ batch.begin() + half, batch.end() });
+    REQUIRE(packed.size() == movers.size());
+
+    for (const auto& box : { raptr::Bounds(0, 3000, 0, 3000), raptr::Bounds(100, 400, 900, 1300), raptr::Bounds(2500, 2600, 10, 40) }) {
+        REQUIRE(query_all(packed, box) == query_all(incremental, box));
+    }
+
+    // A packed tree is still an ordinary tree afterwards
+    for (size_t i = 0; i < half; ++i) {
+        packed.remove(movers[i].handle, movers[i].bounds);
+        incremental.remove(movers[i].handle, movers[i].bounds);
+    }
+    REQUIRE(query_all(packed, raptr::Bounds(0, 3000, 0, 3000)) == query_all(incremental, raptr::Bounds(0, 3000, 0, 3000)));
+}
+
+TEST_CASE("Removing an entry twice or moving entries away leaves nothing behind", "[broadphase]")
+{
+    auto movers = make_movers(200, 1000, 11);
+    for (const auto kind : { "rtree", "hash" }) {
+        auto broadphase = raptr::Broadphase::create(kind, 64);
+        REQUIRE(broadphase);
+        for (const auto& m : movers) {
+            broadphase->insert(m.handle, m.bounds);
+        }
+
+        broadphase->remove(movers[0].handle, movers[0].bounds);
+        broadphase->remove(movers[0].handle, movers[0].bounds);
+        REQUIRE(broadphase->size() == movers.size() - 1);
+    }
+
+    // Cells that empty out are erased, so wandering entities do not grow the table
+    raptr::SpatialHashBroadphase hash(64);
+    for (const auto& m : movers) {
+        hash.insert(m.handle, m.bounds);
+    }
+    for (int32_t step = 0; step < 100; ++step) {
+        for (auto& m : movers) {
+            const auto to = moved(m.bounds, 64, 0);
+            hash.move(m.handle, m.bounds, to);
+            m.bounds = to;
+        }
+    }
+    // No box is bigger than a cell, so each touches at most four
+    REQUIRE(hash.cell_count() <= movers.size() * 4);
+
+    for (const auto& m : movers) {
+        hash.remove(m.handle, m.bounds);
+    }
+    REQUIRE(hash.size() == 0);
+    REQUIRE(hash.cell_count() == 0);
+}
+
+TEST_CASE("Fat bounds are padded and stretched towards the predicted move", "[broadphase]")
+{
+    const raptr::Bounds exact(10, 20, 10, 20);
+    const auto fat = raptr::fatten_bounds(exact, 2, 5, -3);
+
+    REQUIRE(fat.min[0] == 8);
+    REQUIRE(fat.max[0] == 27);
+    REQUIRE(fat.min[1] == 5);
+    REQUIRE(fat.max[1] == 22);
+
+    REQUIRE(raptr::bounds_contain(fat, exact));
+    REQUIRE(raptr::bounds_contain(fat, moved(exact, 5, -3)));
+    REQUIRE_FALSE(raptr::bounds_contain(fat, moved(exact, -3, 0)));
+}
+
+TEST_CASE("Filtered queries only report entries whose tags match", "[broadphase]")
+{
+    for (const auto kind : { "rtree", "hash" }) {
+        auto broadphase = raptr::Broadphase::create(kind, 64);
+        std::vector<raptr::SlotHandle> handles;
+        for (uint32_t i = 0; i < 30; ++i) {
+            raptr::BroadphaseTag tag;
+            tag.category = 1u << (i % 3);
+            tag.mask = i % 5 == 0 ? 0u : ~0u;
+            tag.kind = static_cast<uint8_t>(i % 2);
+            handles.push_back(raptr::SlotHandle::make(i, 1));
+            broadphase->insert(handles.back(), raptr::Bounds(i * 10.0, i * 10.0 + 8, 0, 8), tag);
+        }
+
+        const raptr::Bounds box(0, 400, 0, 8);
+        REQUIRE(query_all(*broadphase, box).size() == 30);
+
+        raptr::BroadphaseFilter filter;
+        filter.category = 1;
+        filter.mask = 1u << 1;
+        filter.kinds = 1u << 1;
+
+        std::vector<uint32_t> expected;
+        for (uint32_t i = 0; i < 30; ++i) {
+            if (i % 3 == 1 && i % 5 != 0 && i % 2 == 1) {
+                expected.push_back(handles[i].value);
+            }
+        }
+
+        const auto query_filtered = [&]() {
+            std::vector<uint32_t> found;
+            broadphase->query(
+                box, &filter, [](raptr::SlotHandle handle, void* context) -> bool {
+                    reinterpret_cast<std::vector<uint32_t>*>(context)->push_back(handle.value);
+                    return true;
+                },
+                &found);
+            std::sort(found.begin(), found.end());
+            return found;
+        };
+        REQUIRE(query_filtered() == expected);
+
+        // Tags survive a move, and can be replaced
+        broadphase->move(handles[7], raptr::Bounds(70, 78, 0, 8), raptr::Bounds(300, 308, 0, 8));
+        REQUIRE(query_filtered() == expected);
+
+        raptr::BroadphaseTag retagged;
+        retagged.category = 1u << 1;
+        retagged.kind = 1;
+        broadphase->retag(handles[2], raptr::Bounds(20, 28, 0, 8), retagged);
+        expected.insert(std::lower_bound(expected.begin(), expected.end(), handles[2].value), handles[2].value);
+        REQUIRE(query_filtered() == expected);
+    }
+}
+
+TEST_CASE("Unknown broadphases are rejected", "[broadphase]")
+{
+    REQUIRE_FALSE(raptr::Broadphase::create("quadtree"));
+    REQUIRE_FALSE(raptr::Broadphase::create("hash", 0));
+}
+
+// Not run by default: raptr-tests "[.benchmark]"
+TEST_CASE("Broadphase update and query cost for moving entities", "[.benchmark][broadphase]")
+{
+    using clock = std::chrono::steady_clock;
+    const int32_t ticks = 60;
+
+    for (const size_t count : { 1000, 5000, 20000, 50000 }) {
+        // Keep the density roughly constant as the count grows
+        const double world = 64.0 * std::sqrt(static_cast<double>(count)) * 4;
+        const auto movers = make_movers(count, world, 42);
+
+        for (const auto kind : { "rtree", "hash" }) {
+            auto broadphase = raptr::Broadphase::create(kind, 64);
+            auto current = movers;
+            for (const auto& m : current) {
+                broadphase->insert(m.handle, m.bounds);
+            }
+
+            size_t hits = 0;
+            const auto start = clock::now();
+            for (int32_t tick = 0; tick < ticks; ++tick) {
+                for (auto& m : current) {
+                    const auto to = moved(m.bounds, m.vx, m.vy);
+                    broadphase->move(m.handle, m.bounds, to);
+                    m.bounds = to;
+                }
+                for (size_t i = 0; i < current.size(); i += 4) {
+                    hits += broadphase->query(current[i].bounds, [](raptr::SlotHandle, void*) -> bool { return true; }, nullptr);
+                }
+            }
+            const auto ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+            WARN(kind << " " << count << " entities: " << ms / ticks << "ms per tick (" << hits << " hits)");
+        }
+    }
+}
+
+// Not run by default: raptr-tests "[.benchmark]"
+TEST_CASE("R-tree build and query cost for static geometry, inserted or bulk loaded", "[.benchmark][broadphase]")
+{
+    using clock = std::chrono::steady_clock;
+
+    for (const size_t count : { 10000, 100000 }) {
+        const double world = 64.0 * std::sqrt(static_cast<double>(count)) * 4;
+        const auto movers = make_movers(count, world, 3);
+        std::vector<raptr::BroadphaseEntry> batch;
+        for (const auto& m : movers) {
+            batch.push_back({ m.handle, m.bounds, raptr::BroadphaseTag() });
+        }
+
+        for (const bool bulk : { false, true }) {
+            raptr::RTreeBroadphase tree;
+            const auto start = clock::now();
+            if (bulk) {
+                tree.insert_batch(batch);
+            } else {
+                for (const auto& entry : batch) {
+                    tree.insert(entry.handle, entry.bounds);
+                }
+            }
+            const auto built = clock::now();
+
+            size_t hits = 0;
+            for (const auto& m : movers) {
+                hits += tree.query(m.bounds, [](raptr::SlotHandle, void*) -> bool { return true; }, nullptr);
+            }
+            const auto queried = clock::now();
+
+            const auto build_ms = std::chrono::duration<double, std::milli>(built - start).count();
+            const auto query_ms = std::chrono::duration<double, std::milli>(queried - built).count();
+            WARN((bulk ? "bulk" : "insert") << " " << count << " boxes: built in " << build_ms << "ms, "
+                                            << count << " queries in " << query_ms << "ms (" << hits << " hits)");
+        }
+    }
+}
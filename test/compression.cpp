@@ -0,0 +1,82 @@
+#include <catch.hpp>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include <raptr/common/compression.hpp>
+
+namespace {
+std::vector<uint8_t> deflate_bytes(const std::vector<uint8_t>& in, int window_bits)
+{
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY);
+
+    std::vector<uint8_t> out(deflateBound(&stream, static_cast<uLong>(in.size())) + 32);
+    stream.next_in = const_cast<Bytef*>(in.data());
+    stream.avail_in = static_cast<uInt>(in.size());
+    stream.next_out = out.data();
+    stream.avail_out = static_cast<uInt>(out.size());
+    deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return out;
+}
+
+std::string as_string(const std::vector<uint8_t>& bytes)
+{
+    return std::string(bytes.begin(), bytes.end());
+}
+}
+
+TEST_CASE("Base64 decodes with and without padding, and rejects what is not base64", "[compression]")
+{
+    std::vector<uint8_t> out;
+    REQUIRE(raptr::base64_decode("Zm9vYmFy", out));
+    REQUIRE(as_string(out) == "foobar");
+    REQUIRE(raptr::base64_decode("Zm9v\nYg==", out));
+    REQUIRE(as_string(out) == "foob");
+    REQUIRE(raptr::base64_decode("Zm9vYmE=", out));
+    REQUIRE(as_string(out) == "fooba");
+    REQUIRE(raptr::base64_decode("", out));
+    REQUIRE(out.empty());
+
+    REQUIRE_FALSE(raptr::base64_decode("Zm9vY", out));
+    REQUIRE_FALSE(raptr::base64_decode("Zm9v!mFy", out));
+    REQUIRE_FALSE(raptr::base64_decode("Zg==Zm9v", out));
+    REQUIRE_FALSE(raptr::base64_decode("Z===", out));
+}
+
+TEST_CASE("zlib and gzip data decompress to exactly the expected size", "[compression]")
+{
+    std::vector<uint8_t> cells;
+    for (uint32_t i = 0; i < 4096; ++i) {
+        const uint32_t index = (i % 7 == 0) ? 0 : (i % 13) | (i % 5 == 0 ? 0x80000000u : 0);
+        for (int32_t b = 0; b < 4; ++b) {
+            cells.push_back(static_cast<uint8_t>(index >> (8 * b)));
+        }
+    }
+
+    const std::pair<raptr::Compression, int> kinds[] = {
+        { raptr::Compression::Zlib, MAX_WBITS },
+        { raptr::Compression::Gzip, MAX_WBITS + 16 },
+    };
+    for (const auto& kind : kinds) {
+        const auto packed = deflate_bytes(cells, kind.second);
+        std::vector<uint8_t> out(cells.size());
+        REQUIRE(raptr::decompress(kind.first, packed.data(), packed.size(), out.data(), out.size()));
+        REQUIRE(out == cells);
+
+        // Too little room, or a stream cut short, is an error rather than a partial layer
+        REQUIRE_FALSE(raptr::decompress(kind.first, packed.data(), packed.size(), out.data(), out.size() - 4));
+        REQUIRE_FALSE(raptr::decompress(kind.first, packed.data(), packed.size() / 2, out.data(), out.size()));
+    }
+
+    raptr::Compression compression;
+    REQUIRE(raptr::compression_from_name("gzip", compression));
+    REQUIRE(compression == raptr::Compression::Gzip);
+    REQUIRE_FALSE(raptr::compression_from_name("lzma", compression));
+}
@@ -0,0 +1,63 @@
+#include <catch.hpp>
+
+#include <raptr/game/game.hpp>
+#include <raptr/game/trigger.hpp>
+
+TEST_CASE("Scheduled thinks keep a single timer per entity", "[game]")
+{
+    auto game = raptr::Game::create_headless(RAPTR_TEST_GAME_ROOT);
+    REQUIRE(game);
+
+    const auto timers_before = game->timers.size();
+    const size_t spawned = 16;
+    for (size_t i = 0; i < spawned; ++i) {
+        auto trigger = raptr::Trigger::from_params({ static_cast<double>(i) * 64, 0, 32, 32 });
+        REQUIRE(trigger->think_rate_us > 0);
+        REQUIRE(game->spawn_now(trigger));
+    }
+
+    // Each think re-arms the timer it fired from rather than adding another
+    for (int32_t round = 0; round < 10; ++round) {
+        game->fast_forward(100);
+        REQUIRE(game->timers.size() == timers_before + spawned);
+    }
+}
+
+TEST_CASE("An event callback can not fast-forward the game", "[game]")
+{
+    auto game = raptr::Game::create_headless(RAPTR_TEST_GAME_ROOT);
+    REQUIRE(game);
+
+    int32_t spawned = 0;
+    double nested = -1;
+    game->spawn_trigger({ 0, 0, 32, 32 }, [&](std::shared_ptr<raptr::Trigger>&) {
+        ++spawned;
+        nested = game->fast_forward(5);
+    });
+
+    const auto tick_before = game->sim_tick;
+    game->fast_forward(1);
+    game->fast_forward(1);
+
+    REQUIRE(spawned == 1);
+    REQUIRE(nested == 0);
+    REQUIRE(game->sim_tick == tick_before + 2);
+}
+
+TEST_CASE("Spawns from the game thread are not limited by the event queue", "[game]")
+{
+    auto game = raptr::Game::create_headless(RAPTR_TEST_GAME_ROOT);
+    REQUIRE(game);
+
+    const auto spawns = static_cast<size_t>(game->config->event_queue_capacity) + 100;
+    size_t spawned = 0;
+    for (size_t i = 0; i < spawns; ++i) {
+        game->spawn_trigger({ static_cast<double>(i % 64) * 32, 0, 16, 16 }, [&](std::shared_ptr<raptr::Trigger>&) {
+            ++spawned;
+        });
+    }
+
+    game->fast_forward(1);
+    REQUIRE(spawned == spawns);
+    REQUIRE(game->event_queue_drops() == 0);
+}
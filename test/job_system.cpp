@@ -0,0 +1,150 @@
+#include <catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <raptr/common/job_system.hpp>
+
+TEST_CASE("Fanned out jobs all run before wait returns", "[job_system]")
+{
+    raptr::JobSystem jobs(3);
+    REQUIRE(jobs.worker_count() == 3);
+
+    std::atomic<int> ran { 0 };
+    std::vector<raptr::JobHandle> handles;
+    for (int i = 0; i < 200; ++i) {
+        handles.push_back(jobs.schedule([&ran]() { ++ran; }));
+    }
+    for (auto& handle : handles) {
+        jobs.wait(handle);
+    }
+    REQUIRE(ran == 200);
+
+    // Chunks cover the range exactly once
+    std::vector<std::atomic<int>> hits(1000);
+    jobs.parallel_for(hits.size(), 7, [&hits](size_t begin, size_t end) {
+        for (auto i = begin; i < end; ++i) {
+            ++hits[i];
+        }
+    });
+    for (auto& hit : hits) {
+        REQUIRE(hit == 1);
+    }
+}
+
+TEST_CASE("A job only runs once its dependencies have finished", "[job_system]")
+{
+    raptr::JobSystem jobs(2);
+
+    std::atomic<int> first_done { 0 };
+    std::atomic<bool> saw_both { false };
+    const auto a = jobs.schedule([&]() { ++first_done; });
+    const auto b = jobs.schedule([&]() { ++first_done; });
+    const auto c = jobs.schedule([&]() { saw_both = first_done == 2; }, { a, b });
+
+    jobs.wait(c);
+    REQUIRE(saw_both);
+}
+
+TEST_CASE("Idle workers steal jobs queued on a busy worker", "[job_system]")
+{
+    raptr::JobSystem jobs(4);
+
+    std::mutex threads_mutex;
+    std::set<std::thread::id> threads;
+
+    // Jobs scheduled from inside a worker go onto that worker's own queue
+    const auto parent = jobs.schedule([&]() {
+        std::vector<raptr::JobHandle> children;
+        for (int i = 0; i < 64; ++i) {
+            children.push_back(jobs.schedule([&]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                std::scoped_lock<std::mutex> lck(threads_mutex);
+                threads.insert(std::this_thread::get_id());
+            }));
+        }
+        for (auto& child : children) {
+            jobs.wait(child);
+        }
+    });
+
+    jobs.wait(parent);
+    REQUIRE(threads.size() > 1);
+}
+
+TEST_CASE("Jobs that wait on jobs they scheduled do not deadlock", "[job_system]")
+{
+    // With a single worker, the waiting job has to run its children itself
+    raptr::JobSystem jobs(1);
+
+    std::atomic<int> leaves { 0 };
+    std::vector<raptr::JobHandle> parents;
+    for (int p = 0; p < 4; ++p) {
+        parents.push_back(jobs.schedule([&]() {
+            std::vector<raptr::JobHandle> children;
+            for (int c = 0; c < 8; ++c) {
+                children.push_back(jobs.schedule([&]() {
+                    jobs.parallel_for(16, 4, [&](size_t begin, size_t end) {
+                        leaves += static_cast<int>(end - begin);
+                    });
+                }));
+            }
+            for (auto& child : children) {
+                jobs.wait(child);
+            }
+        }));
+    }
+
+    for (auto& parent : parents) {
+        jobs.wait(parent);
+    }
+    REQUIRE(leaves == 4 * 8 * 16);
+}
+
+TEST_CASE("An exception thrown by a job is rethrown from wait", "[job_system]")
+{
+    raptr::JobSystem jobs(2);
+
+    const auto failing = jobs.schedule([]() { throw std::runtime_error("boom"); });
+    REQUIRE_THROWS_AS(jobs.wait(failing), std::runtime_error);
+
+    // Its dependents still run, and the pool keeps working
+    std::atomic<bool> ran { false };
+    jobs.wait(jobs.schedule([&ran]() { ran = true; }, { failing }));
+    REQUIRE(ran);
+
+    std::atomic<int> chunks { 0 };
+    REQUIRE_THROWS_AS(jobs.parallel_for(64, 4, [&chunks](size_t begin, size_t) {
+        ++chunks;
+        if (begin == 8) {
+            throw std::logic_error("bad chunk");
+        }
+    }),
+        std::logic_error);
+    REQUIRE(chunks == 16);
+}
+
+TEST_CASE("Workers of one job system schedule into another like outside threads", "[job_system]")
+{
+    raptr::JobSystem outer(2);
+    raptr::JobSystem inner(2);
+
+    std::atomic<int> ran { 0 };
+    const auto job = outer.schedule([&]() {
+        std::vector<raptr::JobHandle> handles;
+        for (int i = 0; i < 32; ++i) {
+            handles.push_back(inner.schedule([&ran]() { ++ran; }));
+        }
+        for (auto& handle : handles) {
+            inner.wait(handle);
+        }
+    });
+
+    outer.wait(job);
+    REQUIRE(ran == 32);
+}
@@ -0,0 +1,62 @@
+#include <catch.hpp>
+
+#include <memory>
+
+#include <raptr/game/map.hpp>
+#include <raptr/renderer/sprite.hpp>
+
+namespace {
+//! A map with one empty 4x4 layer, a plain tile 1 and an animated tile 2
+std::shared_ptr<raptr::Map> make_map()
+{
+    auto sprite = std::make_shared<raptr::Sprite>();
+    sprite->animations["Idle"].name = "Idle";
+    sprite->set_animation("Idle");
+
+    auto map = std::make_shared<raptr::Map>();
+    map->width = 4;
+    map->height = 4;
+    map->tile_width = 16;
+    map->tile_height = 16;
+    map->tilemap.resize(3);
+    map->tilemap[1].image = "plain.png";
+    map->tilemap[1].src = { 0, 0, 16, 16 };
+    map->tilemap[2].sprite = sprite;
+    map->tilemap[2].src = { 0, 0, 16, 16 };
+
+    raptr::Layer layer;
+    layer.name = "Tiles";
+    layer.x = 0;
+    layer.y = 0;
+    layer.width = 4;
+    layer.height = 4;
+    layer.is_foreground = false;
+    layer.cells.resize(16);
+    map->layers.push_back(std::move(layer));
+    return map;
+}
+}
+
+TEST_CASE("Toggling an animated tile reuses its side table slot", "[map]")
+{
+    auto map = make_map();
+    const auto& layer = map->layers.front();
+
+    for (int32_t i = 0; i < 1000; ++i) {
+        REQUIRE(map->set_tile("Tiles", 1, 2, 2));
+        REQUIRE(map->get_tile("Tiles", 1, 2) == 2);
+        REQUIRE(map->set_tile("Tiles", 1, 2, i % 2 ? 0 : 1));
+    }
+    REQUIRE(layer.special.size() == 1);
+
+    // A freed slot goes to whichever cell needs one next
+    REQUIRE(map->set_tile("Tiles", 0, 0, 2));
+    REQUIRE(map->set_tile("Tiles", 3, 3, 2));
+    REQUIRE(layer.special.size() == 2);
+    REQUIRE(layer.free_special.empty());
+
+    REQUIRE(map->set_tile("Tiles", 0, 0, 0));
+    REQUIRE(map->set_tile("Tiles", 3, 3, 1));
+    REQUIRE(layer.free_special.size() == 2);
+    REQUIRE(map->get_tile("Tiles", 3, 3) == 1);
+}
@@ -0,0 +1,31 @@
+#include <catch.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include <raptr/common/mapped_file.hpp>
+
+TEST_CASE("A mapped file reads the same bytes as the file", "[mapped_file]")
+{
+    const auto path = raptr::fs::temp_directory_path() / "raptr-mapped-file-test.bin";
+    std::string contents;
+    for (int32_t i = 0; i < 10000; ++i) {
+        contents.push_back(static_cast<char>(i * 7));
+    }
+
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write(contents.data(), contents.size());
+    }
+
+    {
+        const auto mapped = raptr::MappedFile::open(path);
+        REQUIRE(mapped);
+        REQUIRE(mapped->size() == contents.size());
+        REQUIRE(std::memcmp(mapped->data(), contents.data(), contents.size()) == 0);
+    }
+
+    raptr::fs::remove(path);
+    REQUIRE_FALSE(raptr::MappedFile::open(path));
+}
@@ -0,0 +1,78 @@
+#include <catch.hpp>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <raptr/common/mpsc_queue.hpp>
+
+TEST_CASE("Items pop in the order they were pushed", "[mpsc_queue]")
+{
+    raptr::MpscQueue<std::string> queue(4);
+    REQUIRE(queue.capacity() == 4);
+    REQUIRE(queue.try_push(std::string("a")));
+    REQUIRE(queue.try_push(std::string("b")));
+    REQUIRE(queue.depth() == 2);
+
+    std::string out;
+    REQUIRE(queue.try_pop(out));
+    REQUIRE(out == "a");
+    REQUIRE(queue.try_pop(out));
+    REQUIRE(out == "b");
+    REQUIRE_FALSE(queue.try_pop(out));
+}
+
+TEST_CASE("A full queue drops and counts the push", "[mpsc_queue]")
+{
+    raptr::MpscQueue<int> queue(2);
+    REQUIRE(queue.try_push(1));
+    REQUIRE(queue.try_push(2));
+    REQUIRE_FALSE(queue.try_push(3));
+    REQUIRE(queue.drops() == 1);
+
+    int out;
+    REQUIRE(queue.try_pop(out));
+    REQUIRE(queue.try_push(3));
+    REQUIRE(queue.drops() == 1);
+}
+
+TEST_CASE("Every item from many producers is popped exactly once", "[mpsc_queue]")
+{
+    constexpr int producers = 4;
+    constexpr int per_producer = 10000;
+    raptr::MpscQueue<int> queue(256);
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&queue, p]() {
+            for (int i = 0; i < per_producer; ++i) {
+                while (!queue.try_push(p * per_producer + i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    std::vector<int> seen(producers * per_producer, 0);
+    std::vector<int> last(producers, -1);
+    int received = 0;
+    while (received < producers * per_producer) {
+        int value;
+        if (!queue.try_pop(value)) {
+            continue;
+        }
+        ++seen[value];
+        // Each producer's items stay in order
+        REQUIRE(value % per_producer > last[value / per_producer]);
+        last[value / per_producer] = value % per_producer;
+        ++received;
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    for (auto count : seen) {
+        REQUIRE(count == 1);
+    }
+}
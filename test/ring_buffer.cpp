@@ -0,0 +1,82 @@
+#include <catch.hpp>
+
+#include <string>
+#include <vector>
+
+#include <raptr/common/ring_buffer.hpp>
+
+TEST_CASE("The ring keeps its order as it wraps around", "[ring_buffer]")
+{
+    raptr::RingBuffer<int> ring(3);
+    REQUIRE(ring.capacity() == 4);
+
+    // Push and pop in lockstep so the head walks past the end several times
+    int next_in = 0;
+    int next_out = 0;
+    for (int32_t round = 0; round < 10; ++round) {
+        while (ring.size() < 3) {
+            ring.push_back() = next_in++;
+        }
+        for (int32_t i = 0; i < 2; ++i) {
+            REQUIRE(ring.front() == next_out++);
+            ring.pop_front();
+        }
+    }
+
+    REQUIRE(ring.capacity() == 4);
+    REQUIRE(ring.growths() == 0);
+    while (!ring.empty()) {
+        REQUIRE(ring.front() == next_out++);
+        ring.pop_front();
+    }
+    REQUIRE(next_out == next_in);
+}
+
+TEST_CASE("Growing a wrapped ring keeps its order", "[ring_buffer]")
+{
+    raptr::RingBuffer<int> ring(4);
+    for (int i = 0; i < 4; ++i) {
+        ring.push_back() = i;
+    }
+    ring.pop_front();
+    ring.pop_front();
+
+    // The back wraps to the start of the storage, then the next push doubles it
+    ring.push_back() = 4;
+    ring.push_back() = 5;
+    REQUIRE(ring.size() == ring.capacity());
+    ring.push_back() = 6;
+
+    REQUIRE(ring.capacity() == 8);
+    REQUIRE(ring.growths() == 1);
+    std::vector<int> out;
+    while (!ring.empty()) {
+        out.push_back(ring.front());
+        ring.pop_front();
+    }
+    REQUIRE(out == std::vector<int> { 2, 3, 4, 5, 6 });
+}
+
+TEST_CASE("Popped slots are reused without being destroyed", "[ring_buffer]")
+{
+    raptr::RingBuffer<std::string> ring(2);
+
+    auto& first = ring.push_back();
+    first.assign(256, 'x');
+    const auto* storage = first.data();
+    const auto reserved = first.capacity();
+    ring.pop_front();
+
+    // The next claim of the same slot still holds the old record and its allocation
+    ring.push_back() = "b";
+    auto& reused = ring.push_back();
+    REQUIRE(&reused == &first);
+    REQUIRE(reused.size() == 256);
+    reused = "c";
+    REQUIRE(reused.data() == storage);
+    REQUIRE(reused.capacity() == reserved);
+
+    ring.pop_back();
+    REQUIRE(ring.size() == 1);
+    REQUIRE(ring.front() == "b");
+}
@@ -0,0 +1,64 @@
+#include <catch.hpp>
+
+#include <string>
+
+#include <raptr/common/slot_map.hpp>
+
+TEST_CASE("Handles resolve to the values they were given for", "[slot_map]")
+{
+    raptr::SlotMap<std::string> slots;
+    const auto a = slots.insert("a");
+    const auto b = slots.insert("b");
+
+    REQUIRE(slots.size() == 2);
+    REQUIRE(*slots.get(a) == "a");
+    REQUIRE(*slots.get(b) == "b");
+}
+
+TEST_CASE("A reused slot does not resolve through a stale handle", "[slot_map]")
+{
+    raptr::SlotMap<std::string> slots;
+    const auto a = slots.insert("a");
+    REQUIRE(slots.erase(a));
+    REQUIRE_FALSE(slots.erase(a));
+    REQUIRE(slots.get(a) == nullptr);
+
+    const auto c = slots.insert("c");
+    REQUIRE(c.index() == a.index());
+    REQUIRE(c != a);
+    REQUIRE(slots.get(a) == nullptr);
+    REQUIRE(*slots.get(c) == "c");
+}
+
+TEST_CASE("A null handle never resolves", "[slot_map]")
+{
+    raptr::SlotMap<int> slots;
+    slots.insert(1);
+
+    raptr::SlotHandle null_handle {};
+    REQUIRE_FALSE(null_handle);
+    REQUIRE(slots.get(null_handle) == nullptr);
+}
+
+TEST_CASE("Inserting into a full slot map fails instead of wrapping", "[slot_map]")
+{
+    raptr::SlotMap<int> slots;
+    raptr::SlotHandle last {};
+    size_t inserted = 0;
+    for (size_t i = 0; i < raptr::SlotMap<int>::max_size; ++i) {
+        last = slots.insert(static_cast<int>(i));
+        inserted += last ? 1 : 0;
+    }
+    REQUIRE(inserted == raptr::SlotMap<int>::max_size);
+    REQUIRE(last.index() == raptr::SlotHandle::index_mask);
+
+    REQUIRE_FALSE(slots.insert(-1));
+    REQUIRE(slots.size() == raptr::SlotMap<int>::max_size);
+    REQUIRE(*slots.get(raptr::SlotHandle::make(0, 1)) == 0);
+
+    // Erasing makes room again
+    REQUIRE(slots.erase(last));
+    const auto reused = slots.insert(-1);
+    REQUIRE(reused);
+    REQUIRE(*slots.get(reused) == -1);
+}
@@ -0,0 +1,52 @@
+#include <catch.hpp>
+
+#include <raptr/common/sweep.hpp>
+
+TEST_CASE("A swept box stops at the first face it reaches", "[sweep]")
+{
+    const raptr::Rect wall(100, 0, 10, 100);
+    const raptr::Rect mover(0, 10, 20, 20);
+    raptr::SweepContact contact;
+
+    REQUIRE(raptr::sweep_rect(mover, { 160, 0 }, wall, contact));
+    REQUIRE(contact.toi == Approx(80.0 / 160.0));
+    REQUIRE(contact.normal.x == -1);
+    REQUIRE(contact.normal.y == 0);
+
+    // Far faster than the wall is thick still hits it
+    REQUIRE(raptr::sweep_rect(mover, { 5000, 0 }, wall, contact));
+    REQUIRE(contact.toi * 5000 == Approx(80));
+
+    REQUIRE_FALSE(raptr::sweep_rect(mover, { 60, 0 }, wall, contact));
+    REQUIRE_FALSE(raptr::sweep_rect(mover, { -160, 0 }, wall, contact));
+}
+
+TEST_CASE("Touching boxes only collide when moving into each other", "[sweep]")
+{
+    const raptr::Rect floor(0, 0, 200, 10);
+    const raptr::Rect standing(50, 10, 20, 20);
+    raptr::SweepContact contact;
+
+    REQUIRE_FALSE(raptr::sweep_rect(standing, { 40, 0 }, floor, contact));
+    REQUIRE_FALSE(raptr::sweep_rect(standing, { 0, 30 }, floor, contact));
+
+    REQUIRE(raptr::sweep_rect(standing, { 10, -5 }, floor, contact));
+    REQUIRE(contact.toi == 0);
+    REQUIRE(contact.normal.y == 1);
+}
+
+TEST_CASE("Boxes that start out overlapping collide immediately", "[sweep]")
+{
+    const raptr::Rect block(0, 0, 50, 50);
+    raptr::SweepContact contact;
+
+    REQUIRE(raptr::sweep_rect(raptr::Rect(40, 10, 20, 20), { 3, -8 }, block, contact));
+    REQUIRE(contact.toi == 0);
+    REQUIRE(contact.normal.y == 1);
+
+    const auto swept = raptr::swept_rect(raptr::Rect(10, 10, 5, 5), { -4, 6 });
+    REQUIRE(swept.x == 6);
+    REQUIRE(swept.y == 10);
+    REQUIRE(swept.w == 9);
+    REQUIRE(swept.h == 11);
+}
@@ -0,0 +1,62 @@
+#include <catch.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include <raptr/common/timing_wheel.hpp>
+
+TEST_CASE("Timers fire on the tick they are due, near and far", "[timing_wheel]")
+{
+    raptr::TimingWheel<uint64_t> wheel;
+    const std::vector<uint64_t> dues = { 1, 2, 63, 64, 65, 4095, 4096, 4097, 300000, 20000000 };
+    for (auto due : dues) {
+        wheel.schedule(due, due);
+    }
+
+    std::vector<uint64_t> fired;
+    for (uint64_t tick = 1; wheel.size() > 0; ++tick) {
+        wheel.advance(tick, [&](uint64_t& due) -> uint64_t {
+            REQUIRE(due == tick);
+            fired.push_back(due);
+            return 0;
+        });
+    }
+
+    REQUIRE(fired == dues);
+}
+
+TEST_CASE("A timer in the past fires on the next tick", "[timing_wheel]")
+{
+    raptr::TimingWheel<int> wheel(100);
+    wheel.schedule(10, 1);
+
+    int fired = 0;
+    wheel.advance(101, [&](int&) -> uint64_t {
+        ++fired;
+        return 0;
+    });
+    REQUIRE(fired == 1);
+}
+
+TEST_CASE("Repeating timers keep their id until cancelled", "[timing_wheel]")
+{
+    raptr::TimingWheel<int> wheel;
+    const auto id = wheel.schedule(5, 0);
+
+    int fired = 0;
+    wheel.advance(100, [&](int&) -> uint64_t {
+        ++fired;
+        return wheel.now() + 10;
+    });
+    REQUIRE(fired == 10);
+
+    REQUIRE(wheel.cancel(id));
+    REQUIRE_FALSE(wheel.cancel(id));
+    REQUIRE(wheel.size() == 0);
+
+    wheel.advance(1000, [&](int&) -> uint64_t {
+        ++fired;
+        return 0;
+    });
+    REQUIRE(fired == 10);
+}